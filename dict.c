@@ -402,8 +402,8 @@ int dict_enumerate(dict *d, int rank, const char **key, const char **val, switch
     if (!d || !key || !val || (rank < 0))
        return -1;
 
-    while ((d->table[rank].key == NULL || d->table[rank].key == DUMMY_PTR) &&
-           (rank<d->size))
+    while ((rank < d->size) &&
+           (d->table[rank].key == NULL || d->table[rank].key == DUMMY_PTR))
        rank++;
 
     if (rank >= d->size) {
@@ -25,46 +25,57 @@ SWITCH_MODULE_RUNTIME_FUNCTION(mod_hamradio_runtime);
 SWITCH_MODULE_LOAD_FUNCTION(mod_hamradio_load);
 SWITCH_MODULE_DEFINITION(mod_hamradio, mod_hamradio_load, mod_hamradio_shutdown, mod_hamradio_runtime);
 
+static switch_status_t radio_add(const int radio);
+static switch_status_t radio_remove(const int radio);
+
 // Wrap some of our radio.c stuff for presentation towards the user
 SWITCH_STANDARD_APP(app_radio_ptt_on) {
-   int radio = 0;
+   int radio = 0, rcu = radio_rcu_read_lock();
    radio_ptt_on(radio);
+   radio_rcu_read_unlock(rcu);
 }
 
 SWITCH_STANDARD_APP(app_radio_conference_ptt_on) {
-   int radio = 0;
-   radio_conf_ptt_on(radio);
+   int conf = (zstr(data) ? 0 : atoi(data)), rcu = radio_rcu_read_lock();
+   radio_conf_ptt_on(conf);
+   radio_rcu_read_unlock(rcu);
 }
 
 SWITCH_STANDARD_APP(app_radio_conference_ptt_off) {
-   int radio = 0;
-   radio_conf_ptt_off(radio);
+   int conf = (zstr(data) ? 0 : atoi(data)), rcu = radio_rcu_read_lock();
+   radio_conf_ptt_off(conf);
+   radio_rcu_read_unlock(rcu);
 }
 
 SWITCH_STANDARD_APP(app_radio_ptt_off) {
-   int radio = 0;
+   int radio = 0, rcu = radio_rcu_read_lock();
    radio_ptt_off(radio);
+   radio_rcu_read_unlock(rcu);
 }
 
 SWITCH_STANDARD_APP(app_radio_power_on) {
-   int radio = 0;
+   int radio = 0, rcu = radio_rcu_read_lock();
    radio_power_on(radio);
+   radio_rcu_read_unlock(rcu);
 }
 
 SWITCH_STANDARD_APP(app_radio_power_off) {
-   int radio = 0;
+   int radio = 0, rcu = radio_rcu_read_lock();
    radio_power_off(radio);
+   radio_rcu_read_unlock(rcu);
 }
 
 SWITCH_STANDARD_APP(app_radio_enable) {
     // XXX: Figure out which radio need's enabled
-    int radio = 0;
-    radio_enable(radio);
+    int radio = 0, rcu = radio_rcu_read_lock();
+    radio_cmd_submit(radio, RADIO_CMD_ENABLE, RADIO_IDLE);
+    radio_rcu_read_unlock(rcu);
 }
 
 SWITCH_STANDARD_APP(app_radio_disable) {
-   int radio = 0;
-   radio_disable(radio);
+   int radio = 0, rcu = radio_rcu_read_lock();
+   radio_cmd_submit(radio, RADIO_CMD_DISABLE, RADIO_OFF);
+   radio_rcu_read_unlock(rcu);
 }
 
 // XXX: Here we need to figure out what radios are active in a conference and haven't IDed in awhile...
@@ -73,23 +84,34 @@ SWITCH_STANDARD_APP(app_radio_morse_id) {
    // XXX: Send Morse code ID to chosen radio channels
 }
 
+// What the last (re)load did, for hamradio reload
+static char reload_report[256];
+
 //////////////////////////////////////////////////////////////////////
 // This is our cli interface. Try to make it simple and consistent! //
 //////////////////////////////////////////////////////////////////////
 SWITCH_STANDARD_API(hamradio_function) {
-   int argc, val = 0;
+   int argc, val = 0, rcu = -1;
    char *mycmd = NULL, *argv[3] = { 0 };
+   RadioSnapshot_t snap;
    switch_status_t status = SWITCH_STATUS_SUCCESS;
 
    const char *usage = "USAGE:\n"
                        "   hamradio help\n"
+                       "   hamradio add <radioN>\n"
+                       "   hamradio remove <radioN>\n"
                        "   hamradio power [radio] <on|off>\n"
                        "   hamradio ptt [radio] <on|off>\n"
                        "   hamradio reload\n"
-                       "   hamradio status <radio|all>\n"
+                       "   hamradio status [radio|all] [compact|json|log]\n"
                        "   hamradio disable [radio]\n"
                        "   hamradio enable [radio]\n"
-                       "   hamradio id <radio>\n";
+                       "   hamradio id <radio>\n"
+                       "   hamradio latency [radio] [reset]\n"
+                       "   hamradio stats [radio] [reset]\n"
+                       "   hamradio metrics\n"
+                       "   hamradio export [radio]\n"
+                       "   hamradio transitions\n";
    const char *power_usage = "USAGE:\n"
                        "   hamradio power\n"
                        "     Get all radios POWER status\n"
@@ -123,6 +145,38 @@ SWITCH_STANDARD_API(hamradio_function) {
       goto done;
    }
 
+   // These replace the radio table, so they must run outside of a read section
+   if (!strcasecmp(argv[0], "add") || !strcasecmp(argv[0], "remove")) {
+      int radio;
+
+      if (argc < 2) {
+         stream->write_function(stream, "USAGE:\n   hamradio %s radioN\n", argv[0]);
+         goto done;
+      }
+
+      // Accept either radioN or N
+      radio = atoi(strncasecmp(argv[1], "radio", 5) == 0 ? argv[1] + 5 : argv[1]);
+
+      if (!strcasecmp(argv[0], "add")) {
+         status = radio_add(radio);
+      } else {
+         status = radio_remove(radio);
+      }
+
+      stream->write_function(stream, "%s radio%d: %s\n", argv[0], radio, (status == SWITCH_STATUS_SUCCESS ? "OK" : "FAILED"));
+      status = SWITCH_STATUS_SUCCESS;
+      goto done;
+   } else if (!strcasecmp(argv[0], "reload")) {
+      status = radio_load_configuration(1);
+      radio_rcu_reclaim();
+      stream->write_function(stream, "%s %s\n", (status == SWITCH_STATUS_SUCCESS ? "+OK" : "-ERR"), reload_report);
+      status = SWITCH_STATUS_SUCCESS;
+      goto done;
+   }
+
+   // Everything else just looks at (or pokes) radios in the current table
+   rcu = radio_rcu_read_lock();
+
    if (!strcasecmp(argv[0], "disable")) {
       if (argc < 2) {
          stream->write_function(stream, "USAGE:\n   disable [chan]\t- Disable radio channel [radio]\n");
@@ -130,12 +184,12 @@ SWITCH_STANDARD_API(hamradio_function) {
       }
 
       int radio = atoi(argv[1]);
-      if (radio < 0 || radio >= globals.max_radios) {
+      if (!radio_exists(radio)) {
          err_invalid_radio(radio);
          status = SWITCH_STATUS_FALSE;
          goto done;
       }
-      radio_disable(radio);
+      radio_cmd_submit(radio, RADIO_CMD_DISABLE, RADIO_OFF);
    } else if (!strcasecmp(argv[0], "enable")) {
       if (argc < 2) {
          stream->write_function(stream, "USAGE:\n   enable [chan]\t- Enable radio channel [radio]\n");
@@ -143,12 +197,12 @@ SWITCH_STANDARD_API(hamradio_function) {
       }
 
       int radio = atoi(argv[1]);
-      if (radio < 0 || radio >= globals.max_radios) {
+      if (!radio_exists(radio)) {
          err_invalid_radio(radio);
          status = SWITCH_STATUS_FALSE;
          goto done;
       }
-      radio_enable(radio);
+      radio_cmd_submit(radio, RADIO_CMD_ENABLE, RADIO_IDLE);
    } else if (!strcasecmp(argv[0], "id")) {
       // Has the user specified a channel?
       if (argc == 2) {
@@ -161,9 +215,13 @@ SWITCH_STANDARD_API(hamradio_function) {
          stream->write_function(stream, "POWER STATUS for ALL radios:\n");
 
          for (int radio = 0; radio < globals.max_radios; radio++) {
+            if (!radio_exists(radio)) {
+               continue;
+            }
+
             stream->write_function(stream, "radio%d: power ", radio);
 
-            if (Radios(radio).status == RADIO_OFF) {
+            if (radio_snapshot(radio, &snap) != SWITCH_STATUS_SUCCESS || snap.status == RADIO_OFF) {
                stream->write_function(stream, "off\n");
             } else {
 	       stream->write_function(stream, "on\n");
@@ -173,7 +231,7 @@ SWITCH_STANDARD_API(hamradio_function) {
       } else if (argc == 2) {
          const int radio = atoi(argv[1]);
 
-         if (radio < 0 || radio >= globals.max_radios) {
+         if (!radio_exists(radio)) {
             err_invalid_radio(radio);
             status = SWITCH_STATUS_FALSE;
             goto done;
@@ -181,7 +239,7 @@ SWITCH_STANDARD_API(hamradio_function) {
 
 	 stream->write_function(stream, "radio%d: power ", radio);
 
-	 if (Radios(radio).status == RADIO_OFF) {
+	 if (radio_snapshot(radio, &snap) != SWITCH_STATUS_SUCCESS || snap.status == RADIO_OFF) {
 	    stream->write_function(stream, "off\n");
          } else {
             stream->write_function(stream, "on\n");
@@ -189,22 +247,22 @@ SWITCH_STANDARD_API(hamradio_function) {
       } else if (argc == 3) {
          const int radio = atoi(argv[1]);
 
-         if (radio < 0 || radio >= globals.max_radios) {
+         if (!radio_exists(radio)) {
             err_invalid_radio(radio);
             status = SWITCH_STATUS_FALSE;
             goto done;
          }
 
-         if (!Radios(radio).enabled) {
+         if (radio_get_state(radio) == RADIO_DISABLED) {
 	    stream->write_function(stream, "Ignoring POWER ON for radio%d because it is in DISABLED state\n", radio);
 	    status = SWITCH_STATUS_FALSE;
 	    goto done;
 	 }
 
          if ((val = str_to_intbool(argv[2])) == 1) { 
-            radio_set_state(radio, RADIO_IDLE);
+            radio_cmd_submit(radio, RADIO_CMD_SET_STATE, RADIO_IDLE);
          } else {
-            radio_set_state(radio, RADIO_OFF);
+            radio_cmd_submit(radio, RADIO_CMD_SET_STATE, RADIO_OFF);
          }
 
          stream->write_function(stream, "POWER for radio%d SET to %s\n", radio, (val ? "ON" : "OFF"));
@@ -215,6 +273,10 @@ SWITCH_STANDARD_API(hamradio_function) {
          stream->write_function(stream, "PTT status for ALL radios:\n");
 
          for (int radio = 0; radio < globals.max_radios; radio++) {
+            if (!radio_exists(radio)) {
+               continue;
+            }
+
             stream->write_function(stream, "radio%d: ", radio);
 
 	    if (radio_get_state(radio) == RADIO_TX) {
@@ -227,7 +289,7 @@ SWITCH_STANDARD_API(hamradio_function) {
       } else if (argc == 2) {
          const int radio = atoi(argv[1]);
 
-         if (radio < 0 || radio >= globals.max_radios) {
+         if (!radio_exists(radio)) {
             err_invalid_radio(radio);
             status = SWITCH_STATUS_FALSE;
             goto done;
@@ -243,13 +305,13 @@ SWITCH_STANDARD_API(hamradio_function) {
       } else if (argc == 3) {
          int radio = atoi(argv[1]);
 
-	 if (radio < 0 || radio >= globals.max_radios) {
+	 if (!radio_exists(radio)) {
 	    err_invalid_radio(radio);
 	    status = SWITCH_STATUS_FALSE;
 	    goto done;
 	 }
 
-	 if (!Radios(radio).enabled) {
+	 if (radio_get_state(radio) == RADIO_DISABLED) {
 	    stream->write_function(stream, "Denying PTT request (via cli) for radio%d because it is in DISABLED state.\n", radio);
 	    status = SWITCH_STATUS_FALSE;
 	    goto done;
@@ -262,57 +324,157 @@ SWITCH_STANDARD_API(hamradio_function) {
          }
 
 	 if ((val = str_to_intbool(argv[2])) == 1) {
-	    radio_set_state(radio, RADIO_TX);
+	    radio_cmd_submit(radio, RADIO_CMD_SET_STATE, RADIO_TX);
 	 } else {
-	    radio_set_state(radio, RADIO_IDLE);
+	    radio_cmd_submit(radio, RADIO_CMD_SET_STATE, RADIO_IDLE);
          }
 
          stream->write_function(stream, "PTT for radio %d SET to %s.\n", radio, (val ? "ON" : "OFF"));
 
       }
       goto done;
-   } else if (!strcasecmp(argv[0], "reload")) {
-      radio_load_configuration(1);
-   } else if (!strcasecmp(argv[0], "status")) {
-      int active_radios = 0;
-      switch_bool_t full = 0;
-      
-      if (argc == 1) {
-         full = false;
-      } else {
-         full = true;
+   } else if (!strcasecmp(argv[0], "latency")) {
+      // hamradio latency [radio] [reset] - either argument is optional
+      int radio = -1;
+      switch_bool_t reset = false;
+
+      for (int i = 1; i < argc; i++) {
+         if (!strcasecmp(argv[i], "reset")) {
+            reset = true;
+         } else {
+            radio = atoi(argv[i]);
+
+            if (!radio_exists(radio)) {
+               err_invalid_radio(radio);
+               status = SWITCH_STATUS_FALSE;
+               goto done;
+            }
+         }
       }
 
-      // This is a little gross, but reduces duplication...
-      if (argc == 1 || (argc == 2 && (strcasecmp(argv[1], "all") == 0))) {
-         stream->write_function(stream, "*** Status for ALL radios ***\n");
-         for (int i = 0; i < globals.max_radios; i++) {
-            enum RadioStatus rs = radio_get_state(i);
+      if (!reset && radio < 0) {
+         radio_rt_print_jitter(stream);
+      }
+
+      for (int i = 0; i < globals.max_radios; i++) {
+         if (!radio_exists(i)) {
+            continue;
+         }
 
-	    if (rs > RADIO_OFF) {
-	       active_radios++;
+         if (radio >= 0 && i != radio) {
+            continue;
+         }
+
+         if (reset) {
+            radio_reset_latency(i);
+         } else {
+            radio_print_latency(stream, i);
+         }
+      }
+
+      if (reset) {
+         stream->write_function(stream, "latency histograms reset\n");
+      }
+   } else if (!strcasecmp(argv[0], "metrics")) {
+      radio_metrics_render(stream);
+   } else if (!strcasecmp(argv[0], "stats")) {
+      // hamradio stats [radio] [reset] - either argument is optional
+      int radio = -1;
+      switch_bool_t reset = false;
+
+      for (int i = 1; i < argc; i++) {
+         if (!strcasecmp(argv[i], "reset")) {
+            reset = true;
+         } else {
+            radio = atoi(argv[i]);
+
+            if (!radio_exists(radio)) {
+               err_invalid_radio(radio);
+               status = SWITCH_STATUS_FALSE;
+               goto done;
             }
-            radio_dump_state_var(i, full);
          }
-         stream->write_function(stream, "*** (%d/%d units active) ***\n", active_radios, globals.max_radios);
-      } else if (argc == 2) {
-         int radio = atoi(argv[1]);
+      }
 
-	 if (radio < 0 || radio >= globals.max_radios) {
-	    err_invalid_radio(radio);
-	    status = SWITCH_STATUS_FALSE;
-	    goto done;
-	 }
+      for (int i = 0; i < globals.max_radios; i++) {
+         if (!radio_exists(i) || (radio >= 0 && i != radio)) {
+            continue;
+         }
 
-         radio_dump_state_var(radio, true);
-      } else {
-         stream->write_function(stream, "USAGE:\nhamradio status <radio|all>\n");
+         if (reset) {
+            radio_stats_reset(i);
+         } else {
+            radio_stats_print(stream, i);
+         }
+      }
+
+      if (reset) {
+         stream->write_function(stream, "statistics reset\n");
+      }
+   } else if (!strcasecmp(argv[0], "export")) {
+      // hamradio export [radio] - the settings in use, as hamradio.conf
+      int radio = -1;
+
+      if (argc > 1) {
+         radio = atoi(strncasecmp(argv[1], "radio", 5) == 0 ? argv[1] + 5 : argv[1]);
+
+         if (!radio_exists(radio)) {
+            err_invalid_radio(radio);
+            status = SWITCH_STATUS_FALSE;
+            goto done;
+         }
+      }
+
+      radio_cfg_export(stream, radio);
+   } else if (!strcasecmp(argv[0], "transitions")) {
+      // hamradio transitions - what radio_set_state() does for each change of state
+      radio_fsm_print(stream);
+   } else if (!strcasecmp(argv[0], "status")) {
+      // hamradio status [radio|all] [compact|json|log]
+      RadioStatusFormat_t fmt = STATUS_COMPACT;
+      switch_bool_t to_log = false;
+      int radio = -1;
+
+      for (int i = 1; i < argc; i++) {
+         if (!strcasecmp(argv[i], "json")) {
+            fmt = STATUS_JSON;
+         } else if (!strcasecmp(argv[i], "compact")) {
+            fmt = STATUS_COMPACT;
+         } else if (!strcasecmp(argv[i], "log")) {
+            to_log = true;
+         } else if (!strcasecmp(argv[i], "all")) {
+            radio = -1;
+         } else {
+            radio = atoi(argv[i]);
+
+            if (!radio_exists(radio)) {
+               err_invalid_radio(radio);
+               status = SWITCH_STATUS_FALSE;
+               goto done;
+            }
+         }
+      }
+
+      // The old detailed dump, into the log
+      if (to_log) {
+         for (int i = 0; i < globals.max_radios; i++) {
+            if (radio_exists(i) && (radio < 0 || i == radio)) {
+               radio_dump_state_var(i, true);
+            }
+         }
+         stream->write_function(stream, "+OK status written to the log\n");
          goto done;
       }
+
+      radio_status_render(stream, radio, fmt);
    }
 
 // free up any allocated memories, etc here before returning.
 done:
+   if (rcu >= 0) {
+      radio_rcu_read_unlock(rcu);
+   }
+
    switch_safe_free(mycmd);
    return status;
 }
@@ -320,75 +482,256 @@ done:
 ////////////////////////
 // Configuration Load //
 ////////////////////////
-switch_status_t radio_load_configuration(switch_bool_t reload) {
-   switch_status_t status = SWITCH_STATUS_SUCCESS;
+static void radio_conf_path(char *buf, const size_t len) {
+   const char *conf = switch_core_get_variable("hamradio_conf");
 
-   switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "[mod_hamradio] %sloading configuration from hamradio.conf\n", (reload ? "re" : ""));
+   if (!conf) {
+      const char *conf_dir = switch_core_get_variable("conf_dir");
+      snprintf(buf, len, "%s/%s", conf_dir, HAMRADIO_CONF);
+   } else {
+      snprintf(buf, len, "%s", conf);
+   }
+}
 
-   if (globals.mutex == NULL) { 
-      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "radio_load_configuration - mutex not initialized, failing!\n");
+// Get a freshly configured radio ready for use. Runtime thread (see radio_cmd_call), or while it isn't running
+static void radio_bring_up(const int radio) {
+   Radio_t *r = &Radios(radio);
+
+   switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Bringing up interface radio%d\n", radio);
+
+   // Hook up TOT, penalty and ID timers (left alone if already running)
+   radio_timers_setup(radio);
+
+   // Carry on counting where the last run left off
+   radio_stats_attach(r, radio);
+
+   // Show some userful information in the log
+   radio_dump_state_var(radio, true);
+
+   // Power it up and make it available for use, if enabled (or down, if a reload disabled it)
+   if (r->enabled) {
+      radio_enable(radio);
+   } else if (r->status != RADIO_OFF) {
+      // Directly, like radio_enable(): we're already where commands get run
+      radio_set_state(radio, RADIO_OFF);
+   }
+
+   switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Interface radio%d successfully brought up.\n", radio);
+}
+
+// A change to the radio table, made by the runtime thread for the thread that asked for it
+struct RadioChange {
+   CfgSnapshot_t *snap;			// parsed before handing it over
+   int		radio;			// add/remove
+   switch_bool_t reload;
+   switch_status_t status;
+
+   // What a (re)load did
+   int		applied, removed, unchanged;
+   switch_bool_t gpio_changed;
+   char		changed[128];
+};
+
+static void radio_add_apply(void *data) {
+   struct RadioChange *chg = data;
+
+   if (radio_exists(chg->radio)) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "radio%d already exists, remove it first\n", chg->radio);
+      return;
+   }
+
+   if (dconf_apply_radio(chg->snap, chg->radio) == NULL) {
+      return;
+   }
+
+   // Bring the new radio's lines in alongside everyone else's
+   radio_gpio_rebuild();
+   radio_bring_up(chg->radio);
+
+   globals.gpio_generation++;
+   radio_core_wakeup();
+   chg->status = SWITCH_STATUS_SUCCESS;
+}
+
+// Add a radio from its [radioN] section, leaving every other radio alone
+static switch_status_t radio_add(const int radio) {
+   char conf_path[512];
+   struct RadioChange chg = { .radio = radio, .status = SWITCH_STATUS_FALSE };
+
+   // Parsing can take a while, nothing is locked (or waiting on us) until it's done
+   radio_conf_path(conf_path, sizeof(conf_path));
+
+   if (!(chg.snap = dconf_load_radio(conf_path, radio))) {
       return SWITCH_STATUS_FALSE;
    }
 
    switch_mutex_lock(globals.mutex);
+   radio_cmd_call(radio_add_apply, &chg);
+   switch_mutex_unlock(globals.mutex);
+
+   dconf_free(chg.snap);
+
+   // Free the table we replaced once nobody can be looking at it
+   radio_rcu_reclaim();
+   return chg.status;
+}
+
+static void radio_remove_apply(void *data) {
+   struct RadioChange *chg = data;
+
+   if ((chg->status = radio_table_remove(chg->radio)) == SWITCH_STATUS_SUCCESS) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "radio%d removed\n", chg->radio);
+
+      // Give its lines back
+      radio_gpio_rebuild();
+      globals.gpio_generation++;
+      radio_core_wakeup();
+   }
+}
+
+static switch_status_t radio_remove(const int radio) {
+   struct RadioChange chg = { .radio = radio, .status = SWITCH_STATUS_FALSE };
+
+   switch_mutex_lock(globals.mutex);
+   radio_cmd_call(radio_remove_apply, &chg);
+   switch_mutex_unlock(globals.mutex);
 
-   if (reload == true) {
+   radio_rcu_reclaim();
+   return chg.status;
+}
+
+// Put a parsed configuration in place, touching only what changed
+static void radio_config_apply(void *data) {
+   struct RadioChange *chg = data;
+   CfgSnapshot_t *snap = chg->snap;
+   const char *old_chip, *new_chip;
+   CfgGeneral_t *cfg;
+   switch_bool_t chip_changed, brought_up[RADIO_TABLE_MAX] = { false };
+   size_t used = 0;
+
+   // A different chip means starting GPIO over from scratch
+   old_chip = dconf_str(dconf_current(), "gpiochip", NULL);
+   new_chip = dict_get(snap->general, "gpiochip", NULL);
+   chip_changed = (chg->reload && (old_chip == NULL || new_chip == NULL || strcmp(old_chip, new_chip) != 0));
+
+   if (chip_changed) {
       radio_gpio_fini();
+   }
+
+   // [general], conferences and tones are taken as a whole
+   dconf_apply_general(snap);
+
+   // Counters file, so statistics outlive reloads and restarts (stays mapped across reloads)
+   radio_persist_init();
+
+   // Only radios whose settings differ are touched, the rest keep running undisturbed
+   for (int radio = 0; radio < RADIO_TABLE_MAX; radio++) {
+      Radio_t *staged = dconf_staged(snap, radio);
+
+      if (staged == NULL) {
+         // Gone from the file: drop it like hamradio remove would, its lines go with the rebuild below
+         if (chg->reload && radio_exists(radio) && radio_table_remove(radio) == SWITCH_STATUS_SUCCESS) {
+            switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "radio%d is no longer in hamradio.conf, removed\n", radio);
+            chg->gpio_changed = true;
+            chg->removed++;
+            if (used < sizeof(chg->changed)) {
+               used += snprintf(chg->changed + used, sizeof(chg->changed) - used, "%s-radio%d", (used ? " " : ""), radio);
+            }
+         }
+         continue;
+      }
 
-      // is dictionary existing already? free it if so
-      if (globals.cfg != NULL) {
-         dict_free(globals.cfg);
-         globals.cfg = NULL;
+      if (!dconf_radio_changed(snap, radio)) {
+         chg->unchanged++;
+         continue;
+      }
+
+      if (!radio_exists(radio) || radio_gpio_differs(&Radios(radio), staged)) {
+         chg->gpio_changed = true;
+      }
+
+      if (dconf_apply_radio(snap, radio) == NULL) {
+         continue;
+      }
+
+      brought_up[radio] = true;
+      chg->applied++;
+      if (used < sizeof(chg->changed)) {
+         used += snprintf(chg->changed + used, sizeof(chg->changed) - used, "%sradio%d", (used ? " " : ""), radio);
       }
    }
 
-   // Set a default poll interval early...
-   if (globals.poll_interval == 0)
-      globals.poll_interval = 100;
+   // A new chip starts GPIO over, otherwise only the radios whose lines changed are re-requested
+   if (!chg->reload || chip_changed) {
+      cfg = dconf_hold();
+      radio_gpiochip_init(dconf_str(cfg, "gpiochip", NULL));
+      dconf_release(cfg);
+      radio_gpio_init();
+      chg->gpio_changed = true;
+   } else if (chg->gpio_changed) {
+      radio_gpio_rebuild();
+   }
 
-   // load the dictionary configuration
-   char conf_path[512];
-   
-   const char *conf = switch_core_get_variable("hamradio_conf");
-   if (!conf) {
-      const char *conf_dir = switch_core_get_variable("conf_dir");
-      snprintf(conf_path, sizeof(conf_path), "%s/%s", conf_dir, HAMRADIO_CONF);
-   } else {
-      snprintf(conf_path, sizeof(conf_path), "%s", conf);
+   // step through the radios we (re)configured and get them going
+   for (int radio = 0; radio < RADIO_TABLE_MAX; radio++) {
+      if (brought_up[radio]) {
+         radio_bring_up(radio);
+      }
    }
 
-   if (!(globals.cfg = dconf_load(conf_path))) {
-      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[mod_hamradio] %sloading configuration from hamradio.conf failed. Please examine the DEBUG level log output from mod_hamradio to see why!\n", (reload ? "re" : ""));
-      return SWITCH_STATUS_FALSE;
+   // Let the control thread know it needs to watch the new squelch lines
+   if (chg->gpio_changed) {
+      globals.gpio_generation++;
+      radio_core_wakeup();
    }
 
-   // Initialize GPIO chip(s)
-   radio_gpiochip_init(dconf_get_str("gpiochip", NULL));
+   chg->status = SWITCH_STATUS_SUCCESS;
+}
 
-   // step through all the configured radios and initialize them
-   for (int radio = 0; radio < globals.max_radios; radio++) {
-      Radio_t *r = &Radios(radio);
+switch_status_t radio_load_configuration(switch_bool_t reload) {
+   switch_time_t started = switch_micro_time_now();
+   char conf_path[512];
+   struct RadioChange chg = { .reload = reload, .status = SWITCH_STATUS_FALSE };
 
-      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Bringing up interface radio%d\n", radio);
+   switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "[mod_hamradio] %sloading configuration from hamradio.conf\n", (reload ? "re" : ""));
 
-      // Initialize our mutexes
-      switch_mutex_init(&Radios(radio).mutex, SWITCH_MUTEX_UNNESTED, globals.pool);
+   if (globals.mutex == NULL) { 
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "radio_load_configuration - mutex not initialized, failing!\n");
+      return SWITCH_STATUS_FALSE;
+   }
+
+   // Set a default poll interval early...
+   if (globals.poll_interval == 0)
+      globals.poll_interval = 100;
 
-      // initialize it's GPIO interfaces, if any
-      radio_gpio_init(radio);
+   // Parse everything first, without holding anything up: if that fails, the
+   // running configuration stays as it is
+   radio_conf_path(conf_path, sizeof(conf_path));
+   chg.snap = dconf_load(conf_path);
 
-      // Show some userful information in the log
-      radio_dump_state_var(radio, true);
+   switch_mutex_lock(globals.mutex);
 
-      // Power it up and make it available for use, if enabled
-      if (r->enabled) {
-         radio_enable(radio);
-      }
+   if (!chg.snap) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[mod_hamradio] %sloading configuration from hamradio.conf failed. Please examine the DEBUG level log output from mod_hamradio to see why!\n", (reload ? "re" : ""));
+      snprintf(reload_report, sizeof(reload_report), "failed to load %s, nothing changed", conf_path);
+      switch_mutex_unlock(globals.mutex);
+      return SWITCH_STATUS_FALSE;
+   }
 
-      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Interface radio%d successfully brought up.\n", radio);
+   // The runtime thread puts it in place between its other work
+   if (radio_cmd_call(radio_config_apply, &chg) != SWITCH_STATUS_SUCCESS) {
+      snprintf(reload_report, sizeof(reload_report), "runtime thread didn't get to it, nothing changed");
+   } else {
+      snprintf(reload_report, sizeof(reload_report), "%d radio%s changed, %d removed%s%s, %d unchanged, gpio %s, %ld us",
+               chg.applied, (chg.applied == 1 ? "" : "s"), chg.removed, (chg.changed[0] ? ": " : ""), chg.changed, chg.unchanged,
+               (chg.gpio_changed ? "re-requested" : "untouched"), (long)(switch_micro_time_now() - started));
    }
+   switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "[mod_hamradio] configuration %sloaded: %s\n", (reload ? "re" : ""), reload_report);
+
    switch_mutex_unlock(globals.mutex);
-   return status;
+
+   dconf_free(chg.snap);
+   return chg.status;
 }
 
 static void channel_cb(switch_core_session_t *session, switch_channel_callstate_t callstate, switch_device_record_t *drec) {
@@ -422,14 +765,25 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_hamradio_load) {
 //   switch_mutex_init(&globals.mutex, SWITCH_MUTEX_UNNESTED, pool);
    switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, pool);
 
+   // TOT/penalty/ID deadlines live on the timer wheel
+   if (radio_timer_init() != SWITCH_STATUS_SUCCESS) {
+      return SWITCH_STATUS_FALSE;
+   }
+
    // Load config, halt loading on failure
    if (radio_load_configuration(0) == SWITCH_STATUS_FALSE) {
       return SWITCH_STATUS_FALSE;
    }
 
+   // Hot path logging goes through the trace rings, failure just means logging directly
+   radio_trace_init();
+
    // Add our event hooks
    radio_events_init();
 
+   // Push state changes to event subscribers
+   radio_notify_init();
+
 #if	!defined(NO_HAMLIB)
    // Initialize hamlib interface
    radio_hamlib_init();
@@ -440,9 +794,16 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_hamradio_load) {
    // Define our CLI interface
    SWITCH_ADD_API(globals.api_interface, "hamradio", "hamradio channel controls", hamradio_function, "shows status");	
    switch_console_set_complete("add hamradio help");
+   switch_console_set_complete("add hamradio add");
+   switch_console_set_complete("add hamradio remove");
    switch_console_set_complete("add hamradio status");
    switch_console_set_complete("add hamradio disable");
    switch_console_set_complete("add hamradio enable");
+   switch_console_set_complete("add hamradio latency");
+   switch_console_set_complete("add hamradio stats");
+   switch_console_set_complete("add hamradio metrics");
+   switch_console_set_complete("add hamradio export");
+   switch_console_set_complete("add hamradio transitions");
    switch_console_set_complete("add hamradio power");
    switch_console_set_complete("add hamradio ptt");
    switch_console_set_complete("add hamradio reload");
@@ -456,8 +817,8 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_hamradio_load) {
    SWITCH_ADD_APP(globals.app_interface, "radio_power_off", "Turn POWER relay OFF for radio", "", app_radio_power_off, "", SAF_NONE);
    SWITCH_ADD_APP(globals.app_interface, "radio_ptt_on", "Turn Push To Talk (PTT) relay ON", "", app_radio_ptt_on, "", SAF_NONE);
    SWITCH_ADD_APP(globals.app_interface, "radio_ptt_off", "Turn Push To Talk (PTT) relay OFF", "", app_radio_ptt_off, "", SAF_NONE);
-   SWITCH_ADD_APP(globals.app_interface, "radio_conference_ptt_on", "Turn PTT on for all radios in conference except active RX (Repeater mode)", "", app_radio_conference_ptt_on, "", SAF_NONE);
-   SWITCH_ADD_APP(globals.app_interface, "radio_conference_ptt_off", "Turn PTT off for all radios in conference except active RX (Repeater mode)", "", app_radio_conference_ptt_off, "", SAF_NONE);
+   SWITCH_ADD_APP(globals.app_interface, "radio_conference_ptt_on", "Turn PTT on for all radios in conference except active RX (Repeater mode)", "[conference]", app_radio_conference_ptt_on, "", SAF_NONE);
+   SWITCH_ADD_APP(globals.app_interface, "radio_conference_ptt_off", "Turn PTT off for all radios in conference except active RX (Repeater mode)", "[conference]", app_radio_conference_ptt_off, "", SAF_NONE);
  
    // Hook a channel callback so we can see channel events
    switch_channel_bind_device_state_handler(channel_cb, NULL);
@@ -471,15 +832,26 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_hamradio_load) {
 
 /* Called when the system shuts down:  Macro expands to: switch_status_t mod_hamradio_shutdown() */
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_hamradio_shutdown) {
-   switch_mutex_lock(globals.mutex);
-   // Signal our thread that it should die...
-   globals.alive = 0;
    switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "shutting down radio interfaces due to freeswitch shutdown or reload...\n");
 
+   // Signal our thread that it should die, and wait until it has: it uses the
+   // timer wheel, GPIO and the radio table right up until it exits
+   radio_core_stop();
+
+   switch_mutex_lock(globals.mutex);
+
    // turn off PTT and POWER pins, DISABLE the radio
    for (int radio = 0; radio < globals.max_radios; radio++) {
+      if (!radio_exists(radio)) {
+         continue;
+      }
+
+      Radio_t *r = &Radios(radio);
+
       radio_set_state(radio, RADIO_OFF);
-      Radios(radio).enabled = 0;
+      radio_state_write_begin(r);
+      r->enabled = 0;
+      radio_state_write_end(r);
    }
 
 #if	!defined(NO_LIBGPIOD)
@@ -492,9 +864,34 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_hamradio_shutdown) {
    radio_hamlib_fini();
 #endif
    // Free some memory
+   radio_notify_fini();
    radio_events_fini();
+   radio_timer_fini();
+
+   // Retire the radios and their table, and wait for the last readers to let go
+   RadioTable_t *table = radio_table();
+
+   if (table) {
+      for (int radio = 0; radio < table->size; radio++) {
+         if (radio_exists(radio)) {
+            radio_table_retire(table->radio[radio]);
+         }
+      }
+      __atomic_store_n(&globals.radios, NULL, __ATOMIC_SEQ_CST);
+      radio_rcu_retire(table);
+   }
+
+   // ...and the configuration, freed along with them
+   dconf_publish(NULL);
 
    switch_mutex_unlock(globals.mutex);
+   radio_rcu_reclaim();
+
+   // Nothing points into the counters file any more
+   radio_persist_fini();
+
+   // Flush any queued log lines
+   radio_trace_fini();
 
    // Clear our memory before it's returned to freeswitch for reuse...
    switch_safe_free(globals.modname);
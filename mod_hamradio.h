@@ -7,6 +7,7 @@
 #include <string.h>
 #include <errno.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <gpiod.h>
 #include <time.h>
 #include <stdlib.h>
@@ -26,9 +27,38 @@
 
 // ini-style configuration support (yes, i know fs has its own...)
 #include "radio_cfg.h"
+#include "radio_cfg_lex.h"
+
+// Per-radio deadlines (TOT, penalty, ID)
+#include "radio_timer.h"
+
+// hamradio::state events, coalesced per radio
+#include "radio_notify.h"
+
+// Lock-free histograms (latency, etc)
+#include "radio_hist.h"
+#include "radio_stats.h"
+#include "radio_persist.h"
+#include "radio_status.h"
+#include "radio_duty.h"
+#include "radio_trace.h"
+#include "radio_rt.h"
+
+// Squelch debounce
+#include "radio_squelch.h"
+
+// Radio table (add/remove without stopping everything else)
+#include "radio_table.h"
 
 // Common to all radios
 #include "radio.h"
+#include "radio_fsm.h"
+
+// Configuration keys (one table for loading, dumping and export)
+#include "radio_cfg_keys.h"
+
+// Commands for the runtime thread (state changes from other threads)
+#include "radio_cmd.h"
 
 // Support for GPIO controlled (relays/optocouplers and COS/TOS inputs) radios
 #include "radio_gpio.h"
@@ -42,33 +72,42 @@
 // IDentification (CW + voice)
 #include "radio_id.h"
 
+// Runtime (control) thread
+#include "radio_core.h"
+
+// hamradio metrics (Prometheus text format)
+#include "radio_metrics.h"
+
 
 #define	MAX_GPIO	128		// maximum GPIO pin # (this is intentionally high)
 #define	HAMRADIO_CONF	"hamradio.conf" // configuration file
 
 struct RadioEvent {
+   const char *name;			// what [general] events= calls it
    switch_event_types_t event_type;
    char *event_subclass;
    void (*event_handler)(switch_event_t *evt);
+   switch_bool_t bound;
 };
 typedef struct RadioEvent RadioEvent_t;
 
 struct Globals {
    char *modname;
    int alive;				// are we shutting down?
-   int max_radios;			// Highest radio # allowed to be configured
+   int max_radios;			// Slots in the radio table (radios may be added beyond the configured value)
    int max_conferences;			// Maximum allowed concurrent conferences
-   int poll_interval;			// How long to sleep in the housekeeping thread
-                                        // before rescanning the radios. This controls CPU load
-   struct Radio *Radios;		// radio structures
+   int poll_interval;			// Longest the control thread sleeps between housekeeping
+                                        // passes (ms). Squelch edges wake it up immediately
+   struct RadioTable *radios;		// current radio table, use radio_table()/Radios(x)
    switch_mutex_t *mutex;
    switch_memory_pool_t  *pool;		// our memory pool
    switch_api_interface_t *api_interface;
    switch_application_interface_t *app_interface;
-   dict *cfg;				// configuration from .conf
+   struct CfgGeneral *cfg;		// [general] from .conf, see dconf_hold()
    dict *radio_tones;			// Radio tones
    // XXX: This needs moved when we add support for multiple GPIO chips...
    struct gpiod_chip *gpiochip;
+   int gpio_generation;			// bumped whenever GPIO lines are (re)requested
 
    // Auto-ID stuff
    time_t timeout_id;			// max times between IDs
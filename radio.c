@@ -4,6 +4,7 @@
  * Radio control logic, providing abstration around hamlib and GPIO interfaces
  *
  */
+#include <sched.h>
 #include <switch.h>
 #include "mod_hamradio.h"
 
@@ -23,7 +24,7 @@ static const char *radio_status_msgs[6] = {
 static const char *radio_get_status_str(const int radio) {
     Radio_t *r = NULL;
 
-    if (radio < 0 || radio >= globals.max_radios) {
+    if (!radio_exists(radio)) {
        err_invalid_radio(radio);
        return NULL;
     }
@@ -38,10 +39,89 @@ static const char *radio_get_status_str(const int radio) {
     return radio_status_msgs[r->status];
 }
 
+// Name of a state, for places that don't have a radio to ask (trace output)
+const char *radio_status_name(const int status) {
+    if (status < RADIO_OFF || status > RADIO_TX_DATA) {
+       return "Unknown";
+    }
+    return radio_status_msgs[status];
+}
+
+///////////////////////////
+// Run-time state seqlock //
+///////////////////////////
+// Writers are serialized by the radio's mutex and make the sequence odd while
+// they're changing things, readers (radio_snapshot) just retry until they see
+// the same even sequence before and after copying. Readers never block writers.
+void radio_state_write_begin(Radio_t *r) {
+   if (r->mutex) {
+      switch_mutex_lock(r->mutex);
+   }
+
+   __atomic_store_n(&r->state_seq, r->state_seq + 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void radio_state_write_end(Radio_t *r) {
+   __atomic_store_n(&r->state_seq, r->state_seq + 1, __ATOMIC_RELEASE);
+
+   if (r->mutex) {
+      switch_mutex_unlock(r->mutex);
+   }
+}
+
+switch_status_t radio_snapshot(const int radio, RadioSnapshot_t *snap) {
+   Radio_t *r;
+   uint32_t seq;
+
+   if (!radio_exists(radio)) {
+      return SWITCH_STATUS_FALSE;
+   }
+
+   r = &Radios(radio);
+
+   do {
+      // A write is in progress, wait for it to finish
+      while ((seq = __atomic_load_n(&r->state_seq, __ATOMIC_ACQUIRE)) & 1) {
+         sched_yield();
+      }
+
+      snap->enabled = __atomic_load_n(&r->enabled, __ATOMIC_RELAXED);
+      snap->status = __atomic_load_n(&r->status, __ATOMIC_RELAXED);
+      snap->total_rx = __atomic_load_n(&r->cold->total_rx, __ATOMIC_RELAXED);
+      snap->total_tx = __atomic_load_n(&r->cold->total_tx, __ATOMIC_RELAXED);
+      snap->last_rx = __atomic_load_n(&r->last_rx, __ATOMIC_RELAXED);
+      snap->last_tx = __atomic_load_n(&r->last_tx, __ATOMIC_RELAXED);
+      snap->last_id = __atomic_load_n(&r->last_id, __ATOMIC_RELAXED);
+      snap->talk_start = __atomic_load_n(&r->talk_start, __ATOMIC_RELAXED);
+      snap->listen_start = __atomic_load_n(&r->listen_start, __ATOMIC_RELAXED);
+      snap->penalty_until = __atomic_load_n(&r->penalty_until, __ATOMIC_RELAXED);
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+   } while (__atomic_load_n(&r->state_seq, __ATOMIC_RELAXED) != seq);
+
+   snap->seq = seq;
+   return SWITCH_STATUS_SUCCESS;
+}
+
+// Penalty seconds left, as of a snapshot
+time_t radio_snapshot_penalty(const RadioSnapshot_t *snap) {
+   uint64_t now = radio_now_ms();
+
+   return (snap->penalty_until > now ? (snap->penalty_until - now + 999) / 1000 : 0);
+}
+
+// (Re)start the TOT penalty, ms from now
+static void radio_penalty_arm(Radio_t *r, const uint64_t ms) {
+   radio_state_write_begin(r);
+   radio_timer_arm(&r->penalty_timer, ms);
+   r->penalty_until = radio_now_ms() + ms;
+   radio_state_write_end(r);
+}
+
 RadioStatus_t radio_enable(const int radio) {
    Radio_t *r = NULL;
 
-   if (radio < 0 || radio >= globals.max_radios) {
+   if (!radio_exists(radio)) {
       err_invalid_radio(radio);
       return RADIO_ERROR;
    }
@@ -55,7 +135,9 @@ RadioStatus_t radio_enable(const int radio) {
 
    switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "[radio] enabling radio%d as requested.\n", radio);
    // Enable the radio
+   radio_state_write_begin(r);
    r->enabled = true;
+   radio_state_write_end(r);
    // Power up the radio
    radio_set_state(radio, RADIO_IDLE);
    return RADIO_IDLE;
@@ -64,7 +146,7 @@ RadioStatus_t radio_enable(const int radio) {
 RadioStatus_t radio_disable(const int radio) {
    Radio_t *r = NULL;
 
-   if (radio < 0 || radio >= globals.max_radios) {
+   if (!radio_exists(radio)) {
       err_invalid_radio(radio);
       return RADIO_ERROR;
    }
@@ -78,7 +160,9 @@ RadioStatus_t radio_disable(const int radio) {
 
    switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "[radio] disabling radio%d as requested.\n", radio);
    // Disable the radio
+   radio_state_write_begin(r);
    r->enabled = false;
+   radio_state_write_end(r);
    // Power down the radio
    radio_set_state(radio, RADIO_OFF);
    return RADIO_OFF;
@@ -89,20 +173,20 @@ RadioStatus_t radio_disable(const int radio) {
 // - Use this interface to ensure TOT, idents, etc work! //
 // All of the radio_*_[on|off] functions call into here. //
 ///////////////////////////////////////////////////////////
-RadioStatus_t radio_set_state(const int radio, RadioStatus_t val) {
+static RadioStatus_t radio_set_state_batch(const int radio, RadioStatus_t val, GPIOBatch_t *gpio) {
+   const RadioTransition_t *t;
    Radio_t *r = NULL;
    RadioStatus_t old_status;
    switch_time_t qso_length = 0; //now = switch_micro_time_now();
    time_t now = time(NULL);
-   switch_status_t rv = SWITCH_STATUS_SUCCESS;
 
    // Negative values aren't allowed in the struct but can be returned in case of error
-   if (val < 0) {
+   if (val < RADIO_OFF || val >= RADIO_STATES) {
       switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[radio] radio_set_state(%d) called for radio%d - A negative value means an error was not correctly handled somewhere upstream... File a bug!\n", val, radio);
       return RADIO_ERROR;
    }
 
-   if (radio < 0 || radio >= globals.max_radios) {
+   if (!radio_exists(radio)) {
       err_invalid_radio(radio);
       return RADIO_ERROR;
    }
@@ -110,250 +194,323 @@ RadioStatus_t radio_set_state(const int radio, RadioStatus_t val) {
    // pointer to the radio struct
    r = &Radios(radio);
 
-   if (r == NULL) {
-      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[radio] set_state(%s) called for radio%d - Cannot find radio data structure\n", radio_status_msgs[val], radio);
-      return RADIO_ERROR;
-   }
-
    // Save the old status, for our informational log message below
    old_status = r->status;
 
    // Shortcut for cases where the state hasn't changed - don't display a message, just ignore the request
    if (old_status == val) {
+      r->ptt_requested = 0;
       return val;
    }
 
+   // Everything this transition does (see radio_fsm.c), refused ones are turned away untouched
+   t = radio_transition(old_status, val);
+
+   if (!(t->actions & FSM_VALID)) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "[radio] radio%d can't go from %s to %s, ignoring\n", radio, radio_status_msgs[old_status], radio_status_msgs[val]);
+      r->ptt_requested = 0;
+      return RADIO_ERROR;
+   }
+
+   // Start the PTT latency clock, unless whoever asked for TX already did
+   if ((t->actions & FSM_PTT_REQUEST) && r->ptt_requested == 0) {
+      r->ptt_requested = radio_now_ns();
+   }
+
+   // Is there a penalty pending on this radio? If so, reset it since someone's trying to make us TX
+   if ((t->actions & FSM_PENALTY_CHECK) && radio_timer_armed(&r->penalty_timer)) {
+      radio_penalty_arm(r, r->timeout_holdoff * 1000);
+      radio_trace(TRACE_PTT_BLOCKED, radio, r->timeout_holdoff, 0);
+      radio_stat_inc(r->cold->stats.ctr->ptt_blocked);
+      r->ptt_requested = 0;
+      return RADIO_BLOCKED;
+   }
+
+   // If we're using GPIO for a line this transition drives (pin_* is set) then make sure it's connected
+   if ((t->ptt != FSM_LINE_KEEP && r->pin_ptt >= 0 && r->gpio_ptt == NULL) ||
+       (t->power != FSM_LINE_KEEP && r->pin_power >= 0 && r->gpio_power == NULL)) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[radio] set_state(%s) called but radio %d doesn't have PTT/POWER gpio plumbed. [ptt:%p power:%p]\n", radio_status_msgs[val], radio, r->gpio_ptt, r->gpio_power);
+      r->ptt_requested = 0;
+      return RADIO_ERROR;
+   }
+
+   // Keying up takes duty cycle budget, none left means no TX until the bucket refills
+   if ((t->actions & FSM_DUTY_START) && !radio_duty_tx_start(radio)) {
+      radio_trace(TRACE_DUTY_BLOCKED, radio, r->cold->duty.pct, r->cold->duty.window_ms / 1000);
+      radio_stat_inc(r->cold->stats.ctr->ptt_blocked);
+      r->ptt_requested = 0;
+      return RADIO_BLOCKED;
+   }
+
+   // Everything from here to the end is one update as far as radio_snapshot() is concerned
+   radio_state_write_begin(r);
+
    // Set the new channel state
    r->status = val;
+   radio_stats_transition(&r->cold->stats, old_status, val);
 
-   // If we're using GPIO for a pin (pin_* is set) then make sure it's connected
-   if (r->pin_ptt >= 0 && r->gpio_ptt == NULL) {
-      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[radio] set_state(%s) called but radio %d doesn't have PTT gpio plumbed. [ptr:%p]\n", radio_status_msgs[val], radio, r->gpio_ptt);
-      rv = SWITCH_STATUS_FALSE;
+   if (t->actions & FSM_TOT_CANCEL) {
+      radio_timer_cancel(&r->tot_timer);
    }
 
-   if (r->pin_power >= 0 && r->gpio_power == NULL) {
-      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[radio] set_state(%s) called but radio %d doesn't have POWER gpio plumbed. [ptr:%p]\n", radio_status_msgs[val], radio, r->gpio_power);
-      rv = SWITCH_STATUS_FALSE;
+   if (t->actions & FSM_DUTY_END) {
+      radio_duty_tx_end(radio);
    }
 
-   // Are any configured controls missing?
-   if (rv == SWITCH_STATUS_FALSE) {
-      return RADIO_ERROR;
+   // Trailing idents are driven by id_timer, see radio_id_expired()
+   if (t->actions & FSM_TALK_END) {
+      if (r->talk_start > 0) {
+         // record statistics about the QSO length
+         qso_length = now - r->talk_start;
+         radio_trace(TRACE_TX_END, radio, qso_length, 0);
+         // save the total time transmitted
+         r->cold->total_tx += qso_length;
+      }
+      // save last time transmitted
+      r->last_tx = now;
+   }
+
+   if (t->actions & FSM_LISTEN_END) {
+      if (r->listen_start > 0) {
+         qso_length = now - r->listen_start;
+         radio_trace(TRACE_RX_END, radio, qso_length, 0);
+         r->cold->total_rx += qso_length;
+      }
+      // save last time received
+      r->last_rx = now;
+   }
+
+   // Clear talk time for TOT
+   if (t->actions & FSM_TALK_CLEAR) {
+      r->talk_start = 0;
+   }
+
+   if (t->actions & FSM_LISTEN_START) {
+      r->listen_start = now;
    }
 
-   // What status has been requested?
-   switch (val) {
-     //////////////////////
-     // Error conditions //
-     //////////////////////
-     case RADIO_BLOCKED:
-        // This is an error - blocked state is decided by the value of (r->talk_start + r->timer_talk) and whether it has passed or not...
-        break;
-     case RADIO_ERROR:
-        err_invalid_radio(radio);
-        break;
-     case RADIO_DISABLED:
-        switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "[radio] set_state() Ignoring state change for radio%d because it is disabled.\n", radio);
-        break;
-     ////////////////////////
-     // Valid radio states //
-     ////////////////////////
-     case RADIO_OFF:
-        // Clear PTT
-        if (r->gpio_ptt) {
-           radio_gpio_ptt_off(radio);
-        }
-
-        // Turn off IGN SENS or POWER RELAY
-        if (r->gpio_power) {
-           radio_gpio_power_off(radio);
-        }
-        break;
-     case RADIO_IDLE:
-        if (r->status == RADIO_TX) {
-           if (r->talk_start > 0) {
-              // Should we send a trailing ident?
-              if ((r->last_id + globals.timeout_id) < now) {
-                 // No ID mode is not permitted on ham bands, but maybe user is IDing manually? throw a warning
-                 switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "radio%d set_state(Idle) should send ID as it's been %lu seconds (> %lu threshold) but ID mode is set to None! We won't ID but ham users must ID to be compliant with government regulations!", radio, (now - r->last_id), globals.timeout_id);
-
-                 switch (globals.id_type) {
-                    // Here we fall through intentionally to save duplication
-                    case ID_BOTH:
-                    case ID_VOICE:
-//                       send_ids_voice(radio);
-                    case ID_CW:
-//                       if (globals.id_type == ID_CW || globals.id_type == ID_BOTH)
-//                          send_ids_cw(radio);
-                    case ID_NONE:
-                       break;
-                 }
-              }
-
-              // record statistics about the QSO length
-              qso_length = now - r->talk_start;
-              switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "[radio] radio%d was transmitting for %lu s...\n", radio, qso_length);
-              // save the total time transmitted
-              r->total_tx += qso_length;
-           }
-           // save last time transmitted
-           r->last_tx = now;
-        }
-
-        // If we were receiving, record statistics
-        if (r->status == RADIO_RX) {
-           if (r->listen_start > 0) {
-              qso_length = now - r->listen_start;
-              switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "[radio] radio%d was receiving for %lu s...\n", radio, qso_length);
-              r->total_rx += qso_length;
-           }
-           // save last time received
-           r->last_rx = now;
-        }
-
-        // Clear PTT before powering on
-        if (r->gpio_ptt) {
-           radio_gpio_ptt_off(radio);
-        }
-
-        // Ensure POWER is ON, if it wasn't previously
-        if (r->gpio_power) {
-           radio_gpio_power_on(radio);
-        }
-
-        // Clear talk time for TOT
-        r->talk_start = 0;
-        break;
-     case RADIO_RX:
-        // Clear PTT before powering on
-        if (r->gpio_ptt) {
-           radio_gpio_ptt_off(radio);
-        }
-
-        // Ensure POWER is ON, if it wasn't previously
-        if (r->gpio_power) {
-           radio_gpio_power_on(radio);
-        }
-
-        r->listen_start = now;
-        break;
-     case RADIO_TX:
-     case RADIO_TX_DATA:
-        // Is there a penalty pending on this radio? If so, reset it since someone's trying to make us TX
-        if (r->penalty > 0) {
-           r->penalty = r->timeout_holdoff;
-           return RADIO_BLOCKED;
-        }
-
-        // Start timers here for TOT, but don't restart it if we didn't stop TXing...
-        if (r->talk_start == 0) {
-           r->talk_start = now;
-        }
-
-        // XXX: If a CAT PTT is available, raise it
-        // if (r->cat_api->Has_PTT)
-        //    radio_cat_ptt_on(radio);
-
-        // if a PTT GPIO is configured, raise it now
-        if (r->gpio_ptt) {
-           radio_gpio_ptt_on(radio);
-        }
-
-        break;
-   }
-
-   switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "[radio] radio%d STATUS change (%s) => (%s)\n", radio, radio_status_msgs[old_status], radio_get_status_str(radio));
-   return r->status;
+   // Start the talk clock, but don't restart it if we didn't stop TXing...
+   if ((t->actions & FSM_TALK_START) && r->talk_start == 0) {
+      r->talk_start = now;
+   }
+
+   // ...and the TOT for whatever's left of timeout_talk on it (back from TX_DATA the clock kept running)
+   if ((t->actions & FSM_TOT_ARM) && r->timeout_talk > 0) {
+      time_t left = r->timeout_talk - (now - r->talk_start);
+
+      radio_timer_arm(&r->tot_timer, (left > 0 ? left * 1000 : 0));
+   }
+
+   // Start counting down to the next ID, if we aren't already
+   if ((t->actions & FSM_ID_ARM) && globals.timeout_id > 0 && !radio_timer_armed(&r->id_timer)) {
+      radio_timer_arm(&r->id_timer, globals.timeout_id * 1000);
+   }
+
+   // XXX: If a CAT PTT is available, raise it
+   // if (r->cat_api->Has_PTT)
+   //    radio_cat_ptt_on(radio);
+
+   // Queue the line changes, they're written together by the caller
+   if (t->ptt != FSM_LINE_KEEP && r->gpio_ptt) {
+      radio_gpio_batch_ptt(gpio, radio, (t->ptt == FSM_LINE_ON));
+   }
+
+   if (t->power != FSM_LINE_KEEP && r->gpio_power) {
+      radio_gpio_batch_power(gpio, radio, (t->power == FSM_LINE_ON));
+   }
+
+   radio_state_write_end(r);
+
+   if (t->actions & FSM_NOTIFY) {
+      radio_trace(TRACE_STATE_CHANGE, radio, old_status, val);
+      radio_notify_state(radio, old_status, val);
+   }
+   return val;
+}
+
+// The lines for a transition have been written
+static void radio_state_committed(const int radio, const RadioStatus_t val) {
+   Radio_t *r;
+
+   if (!radio_exists(radio)) {
+      return;
+   }
+
+   r = &Radios(radio);
+
+   // How long did it take from asking for TX to the line actually being keyed?
+   if (r->ptt_requested) {
+      if ((val == RADIO_TX || val == RADIO_TX_DATA) && r->gpio_ptt) {
+         radio_hist_add(&r->cold->lat_ptt, (radio_now_ns() - r->ptt_requested) / 1000);
+      }
+      r->ptt_requested = 0;
+   }
+}
+
+RadioStatus_t radio_set_state(const int radio, RadioStatus_t val) {
+   GPIOBatch_t gpio;		// line changes for this transition, written in one go
+   RadioStatus_t rv;
+
+   radio_gpio_batch_init(&gpio);
+   rv = radio_set_state_batch(radio, val, &gpio);
+
+   // PTT and POWER change together, in a single write
+   radio_gpio_batch_commit(&gpio);
+   radio_state_committed(radio, rv);
+   return rv;
 }
 
 // Get the current combined (power and ptt) state of the radio
 RadioStatus_t radio_get_state(const int radio) {
-   if (radio < 0 || radio >= globals.max_radios) {
+   RadioSnapshot_t snap;
+
+   if (radio_snapshot(radio, &snap) != SWITCH_STATUS_SUCCESS) {
       err_invalid_radio(radio);
       return RADIO_ERROR;
    }
 
-   if (Radios(radio).enabled == 0) {
+   if (snap.enabled == 0) {
       return RADIO_DISABLED;
    }
 
-   return (Radios(radio).status);
+   return snap.status;
 }
 
 void radio_ptt_on(const int radio) {
-   switch_channel_t *channel;
+   RadioSnapshot_t snap;
+
+   if (radio_snapshot(radio, &snap) != SWITCH_STATUS_SUCCESS) {
+      err_invalid_radio(radio);
+      return;
+   }
 
    // Refuse to TX on disabled radio
-   if (!Radios(radio).enabled) {
+   if (!snap.enabled) {
       switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Denying request to TX on radio%d in DISABLED state!\n", radio);
       return;
    }
 
    // Refuse to TX on radio that is turned off!
-   if (radio_get_state(radio) == RADIO_OFF) {
+   if (snap.status == RADIO_OFF) {
       switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Ignoring request to TX on radio%d in POWERED OFF state!\n", radio);
       return;
    }
 
-   radio_set_state(radio, RADIO_TX);
+   radio_cmd_submit(radio, RADIO_CMD_SET_STATE, RADIO_TX);
 }
 
-void radio_conf_ptt_on(const int radio) {
-  // XXX: Enumerate the radios attached to the channel
-  // XXX: Call radio_ptt_on for each
+// Key (or unkey) every radio in a conference with a single GPIO write. The radio
+// that is receiving is the one feeding the conference, so it's left alone, as are
+// radios that are disabled, powered off or serving a TOT penalty. Runtime thread only.
+int radio_conf_ptt(const int conf, const switch_bool_t on, const uint64_t requested) {
+   RadioStatus_t want = (on ? RADIO_TX : RADIO_IDLE);
+   Conference_t *c;
+   GPIOBatch_t gpio;
+   int changed[CONFERENCE_RADIO_WORDS * 64];
+   int n = 0;
+
+   // No lock: conferences are only replaced on this thread, by a reload's radio_cmd_call()
+   if ((c = radio_conference(conf)) == NULL) {
+      return -1;
+   }
+
+   radio_gpio_batch_init(&gpio);
+
+   for (int w = 0; w < CONFERENCE_RADIO_WORDS; w++) {
+      for (uint64_t bits = c->radios[w]; bits; bits &= bits - 1) {
+         int radio = (w * 64) + __builtin_ctzll(bits);
+         RadioSnapshot_t snap;
+
+         if (radio_snapshot(radio, &snap) != SWITCH_STATUS_SUCCESS || !snap.enabled) {
+            continue;
+         }
+
+         if (on) {
+            // Only idle radios get keyed: OFF stays off, RX is the talker, TX already is
+            if (snap.status != RADIO_IDLE) {
+               continue;
+            }
+
+            if (Radios(radio).ptt_requested == 0) {
+               Radios(radio).ptt_requested = requested;
+            }
+         } else if (snap.status != RADIO_TX && snap.status != RADIO_TX_DATA) {
+            continue;
+         }
+
+         // Penalized radios come back BLOCKED and add nothing to the batch
+         if (radio_set_state_batch(radio, want, &gpio) == want) {
+            changed[n++] = radio;
+         }
+      }
+   }
+
+   // Every PTT line in the conference changes at once
+   radio_gpio_batch_commit(&gpio);
+
+   for (int i = 0; i < n; i++) {
+      radio_state_committed(changed[i], want);
+   }
+
+   return n;
 }
 
-void radio_conf_ptt_off(const int radio) {
-  // XXX: Enumerate the radios attached to the channel
-  // XXX: Call radio_ptt_on for each
+void radio_conf_ptt_on(const int conf) {
+   if (radio_cmd_submit(conf, RADIO_CMD_CONF_PTT_ON, RADIO_TX) == RADIO_ERROR) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Ignoring request to TX on conference%d, no such conference configured!\n", conf);
+   }
 }
 
-void radio_ptt_off(const int radio) {
-   switch_channel_t *channel;
+void radio_conf_ptt_off(const int conf) {
+   if (radio_cmd_submit(conf, RADIO_CMD_CONF_PTT_OFF, RADIO_IDLE) == RADIO_ERROR) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Ignoring request to stop TX on conference%d, no such conference configured!\n", conf);
+   }
+}
 
+void radio_ptt_off(const int radio) {
    if (radio_get_state(radio) == RADIO_OFF) {
       return;
    }
 
-   radio_set_state(radio, RADIO_IDLE);
+   radio_cmd_submit(radio, RADIO_CMD_SET_STATE, RADIO_IDLE);
 }
 
 void radio_power_on(const int radio) {
-   switch_channel_t *channel;
+   RadioSnapshot_t snap;
 
-   if (!Radios(radio).enabled) {
+   if (radio_snapshot(radio, &snap) != SWITCH_STATUS_SUCCESS) {
+      err_invalid_radio(radio);
+      return;
+   }
+
+   if (!snap.enabled) {
       switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Refusing to power on radio%d in DISABLED state. requested by app\n", radio);
       return;
    } else {
       switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Powering ON radio%d by app request\n", radio);
-      radio_set_state(radio, RADIO_IDLE);
+      radio_cmd_submit(radio, RADIO_CMD_SET_STATE, RADIO_IDLE);
    }
 }
 
 void radio_power_off(const int radio) {
-   switch_channel_t *channel;
-
-   switch_assert(channel);
    switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Powering OFF radio%d by app request\n", radio);
-   radio_set_state(radio, RADIO_OFF);
+   radio_cmd_submit(radio, RADIO_CMD_SET_STATE, RADIO_OFF);
 }
 
 void radio_print_status(switch_stream_handle_t *stream, const int radio) {
-   Radio_t *r;
-   
-   if (radio < 0 || radio > globals.max_radios) {
+   RadioStatus_t state;
+
+   if (!radio_exists(radio)) {
       stream->write_function(stream, "invalid radio %d specified\n", radio);
       return;
    }
 
-   r = &Radios(radio);
    stream->write_function(stream, "radio%d: ", radio);
 
-   switch(radio_get_state(radio)) {
+   switch((state = radio_get_state(radio))) {
       // Error conditions are handled here (except DISABLED, since it's not really an error)
       case RADIO_ERROR:
-         if (radio >= globals.max_radios) {
+         if (!radio_exists(radio)) {
             stream->write_function(stream, "invalid radio %d specified\n", radio);
             err_invalid_radio(radio);
          } else {
@@ -365,13 +522,13 @@ void radio_print_status(switch_stream_handle_t *stream, const int radio) {
          break;
       // Any normal state of the radio is handled here
       case RADIO_BLOCKED:
-         stream->write_function(stream, "Blocked due to TOT exceeded. Penalty remaining: %lu s\n", r->penalty);
+         stream->write_function(stream, "Blocked due to TOT exceeded. Penalty remaining: %lu s\n", radio_penalty_remaining(radio));
       case RADIO_OFF:
       case RADIO_IDLE:
       case RADIO_RX:
       case RADIO_TX:
       case RADIO_TX_DATA:
-         stream->write_function(stream, "%s\n", radio_get_status_str(radio));
+         stream->write_function(stream, "%s\n", radio_status_name(state));
          break;
    }
 }
@@ -379,11 +536,12 @@ void radio_print_status(switch_stream_handle_t *stream, const int radio) {
 // XXX: This needs to be improved so that it uses stream->write_function(stream, ...) instead of switch_log_printf *IF* coming from api
 int radio_dump_state_var(const int radio, switch_bool_t detailed) {
    Radio_t *r;
+   RadioSnapshot_t snap;
 //   switch_time_t now = switch_micro_time_now();
    time_t now = time(NULL);
 
    // try to prevent invalid radios as this is used to index an array
-   if (radio < 0 || radio >= globals.max_radios) {
+   if (!radio_exists(radio)) {
       err_invalid_radio(radio);
       return SWITCH_STATUS_FALSE;
    }
@@ -391,48 +549,179 @@ int radio_dump_state_var(const int radio, switch_bool_t detailed) {
    // pointer to the radio struct
    r = &Radios(radio);
 
-   if (r == NULL) {
+   if (r == NULL || radio_snapshot(radio, &snap) != SWITCH_STATUS_SUCCESS) {
       switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[radio] radio_dump_state_var(%d) cannot find radio data structure\n", radio);
       return SWITCH_STATUS_FALSE;
    }
 
-   switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO,    "* radio%d: %s\n", radio, r->description);
-     /*(r->description ? r->description : "")); */
+   switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO,    "* radio%d: %s\n", radio, r->cold->description);
+     /*(r->cold->description ? r->cold->description : "")); */
    switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO,    "    enabled: %s\t\tstatus: %s\n",
-          (r->enabled ? "true" : "false"), radio_get_status_str(radio));
+          (snap.enabled ? "true" : "false"), radio_status_name(snap.status));
 
    if (detailed) {
       char tmp1[30], tmp2[30];	// date string buffers
+      struct tm tm;
       const char date_fmt[19] = "%Y-%m-%d %H:%M:%S";
 
-      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "   sq. mode: %d %s\t\tinband ctcss: %s\n", r->RX_mode,
-          (r->squelch_invert ? "(invert)" : ""), (r->ctcss_inband ? "true" : "false"));
+      const CfgKey_t *k;
+      char val[PATH_MAX + 3];
+
+      // Every setting, straight from the configuration key table
+      for (int i = 0; (k = radio_cfg_key_at(i)) != NULL; i++) {
+         if (k->scope == CFG_GENERAL) {
+            continue;
+         }
+
+         radio_cfg_format(k, r, val, sizeof(val));
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "%21s: %s\n", k->name, val);
+      }
+
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "   squelch edges: %u\tglitches: %u\n", r->squelch.edges, r->squelch.glitches);
 
       // Show time stamps with date for last TX/RX times
       memset(tmp1, 0, sizeof(tmp1));
       memset(tmp2, 0, sizeof(tmp2));
-      if (r->last_rx > 0) {
-         strftime(tmp1, sizeof(tmp1), date_fmt, localtime(&r->last_rx));
+      if (snap.last_rx > 0) {
+         strftime(tmp1, sizeof(tmp1), date_fmt, localtime_r(&snap.last_rx, &tm));
       } else {
          sprintf(tmp1, "Never");
       }
 
-      if (r->last_tx > 0) {
-         strftime(tmp2, sizeof(tmp2), date_fmt, localtime(&r->last_tx));
+      if (snap.last_tx > 0) {
+         strftime(tmp2, sizeof(tmp2), date_fmt, localtime_r(&snap.last_tx, &tm));
       } else {
          sprintf(tmp2, "Never");
       }
 
-      time_t curr_rx = ((r->listen_start > 0) ? (now - r->listen_start) : 0);
-      time_t curr_tx = ((r->talk_start > 0) ? (now - r->talk_start) : 0);
+      time_t curr_rx = ((snap.status == RADIO_RX && snap.listen_start > 0) ? (now - snap.listen_start) : 0);
+      time_t curr_tx = ((snap.talk_start > 0) ? (now - snap.talk_start) : 0);
       switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "    last_rx: %-20.20s\t\tlast_tx: %-20.20s\n", tmp1, tmp2);
-      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "   total_rx: %lu\t\t\ttotal_tx: %lu\n", r->total_rx, r->total_tx);
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "   total_rx: %lu\t\t\ttotal_tx: %lu\n", snap.total_rx, snap.total_tx);
       switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "    curr_rx: %5lu s\t\tcurr_tx: %5lu s\n", curr_rx, curr_tx);
-      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "        tot: %4lu s\t\tholdoff: %4lu s\tpenalty: %4lu s\n",
-          r->timeout_talk, r->timeout_holdoff, r->penalty);
-      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "   pa_indev: %s\n", r->pa_indev);
-      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "  pa_outdev: %s\n", r->pa_outdev);
-      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "  GPIO pins:  ptt=%d, power=%d, squelch=%d\n", r->pin_ptt, r->pin_power, r->pin_squelch);
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "    penalty: %4lu s\n", radio_snapshot_penalty(&snap));
+      if (r->cold->duty.pct > 0) {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "   duty budget left: %ld s\n", radio_duty_remaining(radio));
+      }
    }
    return SWITCH_STATUS_SUCCESS;
 }
+
+////////////
+// Timers //
+////////////
+// The TOT expired while transmitting
+static void radio_tot_expired(const int radio, void *data) {
+   Radio_t *r = &Radios(radio);
+
+   if (r->status != RADIO_TX) {
+      return;
+   }
+
+   radio_trace(TRACE_TOT_EXPIRED, radio, r->timeout_talk, r->timeout_holdoff);
+   radio_stat_inc(r->cold->stats.ctr->tot_trips);
+
+   // Apply a delay before allowing TX again (on top of any that's left)
+   radio_penalty_arm(r, radio_timer_remaining(&r->penalty_timer) + (r->timeout_holdoff * 1000));
+
+   // Turn the PTT off
+   radio_ptt_off(radio);
+}
+
+static void radio_penalty_expired(const int radio, void *data) {
+   Radio_t *r = &Radios(radio);
+
+   radio_state_write_begin(r);
+   r->penalty_until = 0;
+   radio_state_write_end(r);
+
+   radio_trace(TRACE_PENALTY_CLEARED, radio, 0, 0);
+
+   // Optionally Play a status tone to indicate penalty time over
+   radio_send_tones(radio, "penalty_clear");
+}
+
+static void radio_id_expired(const int radio, void *data) {
+   Radio_t *r = &Radios(radio);
+   switch_bool_t keyed = (r->status == RADIO_TX || r->status == RADIO_TX_DATA);
+
+   // Nothing sent since the last ID, nothing to identify
+   if (r->last_tx < r->last_id && !keyed) {
+      return;
+   }
+
+   switch (globals.id_type) {
+      case ID_NONE:
+         // No ID mode is not permitted on ham bands, but maybe user is IDing manually? throw a warning
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "radio%d is due for ID (%ld s since last) but ID mode is set to None! Ham users must ID to be compliant with government regulations!\n", radio, (long)globals.timeout_id);
+         break;
+      case ID_BOTH:
+      case ID_VOICE:
+      case ID_CW:
+         // XXX: send_ids_cw(radio) / send_ids_voice(radio) once they exist, and
+         // have them stamp last_id when the ID actually goes out
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "radio%d is due for ID\n", radio);
+         break;
+   }
+
+   // Still on the air, the next one is due timeout_id from now (FSM_ID_ARM only fires on key up)
+   if (keyed && globals.timeout_id > 0) {
+      radio_timer_arm(&r->id_timer, globals.timeout_id * 1000);
+   }
+}
+
+void radio_timers_setup(const int radio) {
+   Radio_t *r;
+
+   if (!radio_exists(radio)) {
+      err_invalid_radio(radio);
+      return;
+   }
+
+   r = &Radios(radio);
+   radio_timer_setup(&r->tot_timer, "tot", radio, radio_tot_expired, NULL);
+   radio_timer_setup(&r->penalty_timer, "penalty", radio, radio_penalty_expired, NULL);
+   radio_timer_setup(&r->id_timer, "id", radio, radio_id_expired, NULL);
+}
+
+time_t radio_penalty_remaining(const int radio) {
+   if (!radio_exists(radio)) {
+      return 0;
+   }
+
+   // round up, so we never claim 0 while still blocked
+   return (radio_timer_remaining(&Radios(radio).penalty_timer) + 999) / 1000;
+}
+
+/////////////
+// Latency //
+/////////////
+static void radio_print_hist(switch_stream_handle_t *stream, const char *name, RadioHist_t *h) {
+   stream->write_function(stream, "   %-14s n=%-8" PRIu64 " p50=%8" PRIu64 " us  p99=%8" PRIu64 " us  max=%8" PRIu64 " us\n", name,
+      __atomic_load_n(&h->count, __ATOMIC_RELAXED), radio_hist_percentile(h, 50), radio_hist_percentile(h, 99),
+      __atomic_load_n(&h->max, __ATOMIC_RELAXED));
+}
+
+void radio_print_latency(switch_stream_handle_t *stream, const int radio) {
+   Radio_t *r;
+
+   if (!radio_exists(radio)) {
+      stream->write_function(stream, "invalid radio %d specified\n", radio);
+      return;
+   }
+
+   r = &Radios(radio);
+   stream->write_function(stream, "radio%d:\n", radio);
+   radio_print_hist(stream, "squelch->rx", &r->cold->lat_squelch);
+   radio_print_hist(stream, "ptt", &r->cold->lat_ptt);
+}
+
+void radio_reset_latency(const int radio) {
+   if (!radio_exists(radio)) {
+      err_invalid_radio(radio);
+      return;
+   }
+
+   radio_hist_reset(&Radios(radio).cold->lat_squelch);
+   radio_hist_reset(&Radios(radio).cold->lat_ptt);
+}
@@ -9,7 +9,8 @@
 #include <hamlib/rotator.h>
 #endif
 
-#define	Radios(x)	(globals.Radios[x])
+// Only valid for radios that exist (see radio_exists), inside a read section
+#define	Radios(x)	(*radio_table()->radio[x])
 #define	is_radio_enabled(x)	(Radios(x).enabled)
 
 ////////////////
@@ -47,46 +48,26 @@ typedef enum RadioCATMode {
    CAT_TYPE_RAWSERIAL
 } RadioCATMode;
 
-struct Radio {
-   ///// Lock /////
-   switch_mutex_t *mutex;
-
+//
+// A radio is split in two. struct Radio holds what the runtime thread looks
+// at on every pass (state, squelch, GPIO, timers) and lives in one array,
+// indexed by radio #, so a scan walks contiguous cache lines. Everything else
+// (configuration that only matters at setup, hamlib, statistics) hangs off
+// ->cold and is only touched when something actually happens.
+//
+struct RadioCold {
    ///////////////////
    // configuration //
    ///////////////////
-   switch_bool_t	enabled;	// Is channel enabled?
-   switch_bool_t	tx_allowed;	// is transmitting allowed?
    RadioCATMode		CAT_mode;	// CAT control mode
    char		description[250];	// Describe the interface
-   RadioRXMode_t RX_mode;		// How do we decide this radio is hearing something that should be relayed?
-   time_t	timeout_talk;		// How long do we allow someone to talk before stopping TX?
-   time_t	timeout_holdoff;	// How long do we punish triggering the TOT?
    switch_bool_t ctcss_inband;		// Does radio pass CTCSS tones?
-   switch_bool_t squelch_invert;		// Is squelch inpout inverted?
    u_int32_t	squelch_min;		// Minimum value to open squelch
-   // GPIO pins
-   int		pin_power;		// Power or ignition sense relay output
-   switch_bool_t pin_power_invert;	// invert power gpio?
-   int		pin_ptt;		// Push to Talk output
-   switch_bool_t pin_ptt_invert;		// invert ptt gpio?
-   int		pin_squelch;		// Squelch input from radio (optional voltage divider or optocoupler)
 
    // mod_portaudio devices to provide the audio channel
    char	pa_indev[PATH_MAX];		// Input device
    char	pa_outdev[PATH_MAX];		// Output device
 
-   ///////////////////
-   // Run-time data //
-   ///////////////////
-   enum RadioStatus status;
-
-#if	!defined(NO_LIBGPIOD)
-   // libgpiod data
-   struct gpiod_line_request *gpio_power; 	// Power or ignition sense output
-   struct gpiod_line_request *gpio_ptt;		// Push To Talk output
-   struct gpiod_line_request *gpio_squelch;	// squelch (COS or TOS) output from radio
-#endif
-
 #if	!defined(NO_HAMLIB)
    RIG		*rig;
    freq_t 	rig_freq;
@@ -105,23 +86,100 @@ struct Radio {
    ////////////////
    // Statistics //
    ////////////////
-   // Running totals since restart
+   // Running totals since restart (written with the run-time state, see below)
+   time_t	total_rx, total_tx;
+
+   // Latency (us), see hamradio latency
+   RadioHist_t	lat_squelch;		// squelch edge -> radio_set_state(RADIO_RX) done
+   RadioHist_t	lat_ptt;		// PTT requested -> PTT line written
+
+   RadioStats_t	stats;			// sessions, TOT trips, durations (see hamradio stats)
+
+   RadioNotify_t notify;		// hamradio::state events waiting to go out
+   RadioStatusCache_t status;		// pre-rendered hamradio status output
+   RadioDuty_t	duty;			// duty cycle limit and what's left of it
+};
+
+struct Radio {
+   ///////////////////
+   // Run-time data //
+   ///////////////////
+   // status, enabled, penalty_until and the statistics (here and in ->cold) are
+   // only changed between radio_state_write_begin/end, readers use radio_snapshot()
+   uint32_t	state_seq;		// odd while a write is in progress
+   enum RadioStatus status;
+   switch_bool_t	enabled;	// Is channel enabled?
+   RadioRXMode_t RX_mode;		// How do we decide this radio is hearing something that should be relayed?
+   uint64_t	penalty_until;		// TOT penalty ends (ms, radio_now_ms), 0 if none
+
+#if	!defined(NO_LIBGPIOD)
+   // libgpiod data
+   struct gpiod_line_request *gpio_power; 	// Power or ignition sense output
+   struct gpiod_line_request *gpio_ptt;		// Push To Talk output
+   struct gpiod_line_request *gpio_squelch;	// squelch (COS or TOS) output from radio
+#endif
+
+   // When did we last hear/talk, and when was the current TX/RX started?
+   time_t	last_tx, last_id, last_rx;
+   time_t	talk_start, listen_start;
+   uint64_t	ptt_requested;		// when the pending PTT request came in (ns, monotonic)
+
+   ///////////////////
+   // configuration //
+   ///////////////////
+   switch_bool_t	tx_allowed;	// is transmitting allowed?
+   time_t	timeout_talk;		// How long do we allow someone to talk before stopping TX?
+   time_t	timeout_holdoff;	// How long do we punish triggering the TOT?
+   switch_bool_t squelch_invert;		// Is squelch inpout inverted?
+   // GPIO pins
+   int		pin_power;		// Power or ignition sense relay output
+   switch_bool_t pin_power_invert;	// invert power gpio?
+   int		pin_ptt;		// Push to Talk output
+   switch_bool_t pin_ptt_invert;		// invert ptt gpio?
+   int		pin_squelch;		// Squelch input from radio (optional voltage divider or optocoupler)
+   SquelchDebounce_t squelch;		// debounce settings + state for the squelch input
+
+   ////////////
+   // Timers //
+   ////////////
+   RadioTimer_t	tot_timer;		// ends the current TX when timeout_talk expires
+   RadioTimer_t	penalty_timer;		// holdoff (penalty) for exceeding TOT, TX refused while armed
+   RadioTimer_t	id_timer;		// next identification is due
+
+   ///// Lock /////
+   switch_mutex_t *mutex;
+
+   struct RadioCold *cold;		// everything the runtime loop doesn't need
+} __attribute__((aligned(64)));
+
+// A consistent copy of a radio's run-time state
+struct RadioSnapshot {
+   uint32_t	seq;			// state_seq it was taken at, changes with every update
+   switch_bool_t enabled;
+   RadioStatus_t status;
    time_t	total_rx, total_tx;
    time_t	last_tx, last_id, last_rx;
-   // When was the current TX/RX started?
    time_t	talk_start, listen_start;
-   // Remaining holdoff (penalty) time for exceeding TOT, before we will allow a TX
-   time_t	penalty;
+   uint64_t	penalty_until;
 };
+typedef struct RadioSnapshot RadioSnapshot_t;
 
 ////////////////
 // Prototypes //
 ////////////////
 typedef struct Radio Radio_t;
+typedef struct RadioCold RadioCold_t;
+
+// Run-time state: writers bracket changes, readers take a snapshot (never blocks)
+extern void radio_state_write_begin(Radio_t *r);
+extern void radio_state_write_end(Radio_t *r);
+extern switch_status_t radio_snapshot(const int radio, RadioSnapshot_t *snap);
+extern time_t radio_snapshot_penalty(const RadioSnapshot_t *snap);
 
 extern void radio_print_status(switch_stream_handle_t *stream, const int radio);
 extern RadioStatus_t radio_set_state(const int radio, enum RadioStatus val);
 extern RadioStatus_t radio_get_state(const int radio);
+extern const char *radio_status_name(const int status);
 // Enable/disable a radio
 extern RadioStatus_t radio_enable(const int radio);
 extern RadioStatus_t radio_disable(const int radio);
@@ -134,19 +192,30 @@ extern void radio_power_off(const int radio);
 extern void radio_ptt_on(const int radio);
 extern void radio_ptt_off(const int radio);
 // And for all the radios in a conference?
-extern void radio_conf_ptt_on(const int radio);
-extern void radio_conf_ptt_off(const int radio);
+extern void radio_conf_ptt_on(const int conf);
+extern void radio_conf_ptt_off(const int conf);
+// Conference fan-out itself (runtime thread), returns how many radios changed or -1 for no such conference
+extern int radio_conf_ptt(const int conf, const switch_bool_t on, const uint64_t requested);
 
 // Status messages, etc
 extern int radio_dump_state_var(const int radio, switch_bool_t detailed);
 
+// Set up the per-radio deadlines (TOT, penalty, ID) on the timer wheel
+extern void radio_timers_setup(const int radio);
+// Seconds of TOT penalty left before TX is allowed again
+extern time_t radio_penalty_remaining(const int radio);
+
+// Latency histograms
+extern void radio_print_latency(switch_stream_handle_t *stream, const int radio);
+extern void radio_reset_latency(const int radio);
+
 ///////////////////////////////////////
 // And some inlines that belong here //
 ///////////////////////////////////////
 
 // User has asked us to operate on an invalid radio
 static inline void err_invalid_radio(const int radio) {
-   switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "* ERROR - radio%d requested, but system only supports %d radios!\n", radio, dconf_get_int("max_radios", 8));
+   switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "* ERROR - radio%d requested, but there is no such radio configured!\n", radio);
 }
 
 #endif	// !defined(__RADIO_H)
@@ -1,13 +1,16 @@
 /*
  * Our terrible configuration parser.
  *
- * This needs a major overhaul, but works well enough so long as the config file is valid...
+ * hamradio.conf is tokenized in place (see radio_cfg_lex.c), so nothing is
+ * copied unless it's being kept: [general] and [tones] values go into their
+ * dictionaries, radio settings into the radio.
  *
  * The dictionary based (general) part wouldn't be possible without N. Devillard's dictionary.[ch]
  * See dict.[ch] for slightly modified version of his code or search google for original
  */
 #include <stdarg.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <ctype.h>
 #include <time.h>
 #include <switch.h>
@@ -15,92 +18,201 @@
 #include <string.h>
 #include "mod_hamradio.h"
 
-dict *dconf_load(const char *file) {
-   int line = 0, errors = 0, warnings = 0;
-   int         in_comment = 0;
-   char buf[768];
-   FILE *fp;
-   char *end, *skip,
-        *key, *val,
-        *section = NULL;
-   dict *cp = dict_new();
-
-   if ((fp = fopen(file, "r")) == NULL) {
-      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "mod_hamdradio: %s: Failed loading '%s'\n", __FUNCTION__, file);
+// What the section we're in holds, worked out once when it opens
+typedef enum CfgSection {
+   SECT_NONE = 0,		// before the first section, or after @END
+   SECT_SKIP,			// ignored (bad radio, or not the one we're loading)
+   SECT_GENERAL,
+   SECT_CONFERENCE,
+   SECT_TONES,
+   SECT_RADIO,
+   SECT_UNKNOWN
+} CfgSection_t;
+
+// A [radioN] section, parsed but not applied
+struct CfgRadio {
+   Radio_t	hot;
+   RadioCold_t	cold;
+};
+
+// Staged radio settings, allocated the first time its section shows up
+static Radio_t *cfg_stage_radio(CfgSnapshot_t *snap, const int radio) {
+   void *p;
+
+   if (snap->radio[radio] == NULL) {
+      // Radio_t wants its own cache lines
+      if (posix_memalign(&p, 64, sizeof(struct CfgRadio)) != 0) {
+         return NULL;
+      }
+
+      memset(p, 0, sizeof(struct CfgRadio));
+      snap->radio[radio] = p;
+      snap->radio[radio]->hot.cold = &snap->radio[radio]->cold;
+      // same defaults as a fresh radio_table_slot()
+      snap->radio[radio]->hot.pin_power = snap->radio[radio]->hot.pin_ptt = snap->radio[radio]->hot.pin_squelch = -1;
+   }
+
+   return &snap->radio[radio]->hot;
+}
+
+void dconf_free(CfgSnapshot_t *snap) {
+   if (snap == NULL) {
+      return;
+   }
+
+   if (snap->general) {
+      dict_free(snap->general);
+   }
+
+   if (snap->tones) {
+      dict_free(snap->tones);
+   }
+
+   switch_safe_free(snap->settings);
+   switch_safe_free(snap->conferences);
+
+   for (int i = 0; i < RADIO_TABLE_MAX; i++) {
+      switch_safe_free(snap->radio[i]);
+   }
+
+   switch_safe_free(snap->radio);
+   free(snap);
+}
+
+// Parse the whole file, or (only_radio >= 0) just the [radioN] section for that radio
+static CfgSnapshot_t *dconf_parse(const char *file, const int only_radio) {
+   int errors = 0, warnings = 0, stored = 0;
+   int radio = -1;
+   CfgLexer_t lx;
+   CfgTok_t tok;
+   CfgSection_t sect = SECT_NONE;
+   const char *section = NULL;
+   char *key, *val;
+   Radio_t *r = NULL;
+   const CfgKey_t *k;
+   switch_time_t started = switch_micro_time_now();
+   CfgSnapshot_t *snap;
+   dict *cp;
+
+   if (cfg_lex_open(&lx, file) != SWITCH_STATUS_SUCCESS) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "mod_hamdradio: %s: Failed loading '%s': %s\n", __FUNCTION__, file, strerror(errno));
       return NULL;
    }
 
-   // We need to use safer string functions...
-   do {
-      memset(buf, 0, sizeof(buf));
-      char *discard = fgets(buf, sizeof(buf) - 1, fp);
-      line++;
+   if ((snap = calloc(1, sizeof(*snap))) == NULL || (snap->radio = calloc(RADIO_TABLE_MAX, sizeof(*snap->radio))) == NULL) {
+      switch_safe_free(snap);
+      cfg_lex_close(&lx);
+      return NULL;
+   }
 
-      // delete prior whitespace...
-      skip = buf;
-      while(*skip == ' ') {
-        skip++;
+   cp = snap->general = dict_new();
+
+   // [general], conferences and tones come from a full load only: staged
+   // from scratch (keys not in the file keep their running values), and
+   // only put in place by dconf_apply_general()
+   if (only_radio < 0) {
+      if ((snap->settings = malloc(sizeof(*snap->settings))) == NULL ||
+          (snap->conferences = calloc(CONFERENCE_MAX, sizeof(*snap->conferences))) == NULL ||
+          (snap->tones = dict_new()) == NULL) {
+         dconf_free(snap);
+         cfg_lex_close(&lx);
+         return NULL;
       }
 
-      // Delete trailing newlines or white space
-      end = buf + strlen(buf);
-      do {
-        *end = '\0';
-        end--;
-      } while(*end == '\r' || *end == '\n' || *end == ' ');
+      memcpy(snap->settings, &globals, sizeof(*snap->settings));
+      radio_conference_reset(snap->conferences);
+   }
 
-      // did we eat the whole line?
-      if ((end - skip) <= 0) {
+   while (cfg_lex_next(&lx, &tok) != CFG_TOK_EOF) {
+      if (tok.type == CFG_TOK_ERROR) {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "config %s:%d:%d: %s: %s\n", file, tok.line, tok.col, tok.error, tok.key);
+         errors++;
          continue;
       }
 
-      // handle comments
-      if (skip[0] == '*' && skip[1] == '/') {
-         in_comment = 0;               /* end of block comment */
+      if (tok.type == CFG_TOK_SECTION_END) {
+         // @END exits a section early
+         sect = SECT_NONE;
          continue;
-      } else if (skip[0] == ';' || skip[0] == '#' || (skip[0] == '/' && skip[1] == '/')) {
-         continue;                     /* line comment */
-      } else if (skip[0] == '/' && skip[1] == '*') {
-         in_comment = 1;               /* start of block comment */
       }
 
-      if (in_comment) {
-         continue;                     /* ignored line, in block comment */
-      }
+      if (tok.type == CFG_TOK_SECTION) {
+         section = tok.key;
+         radio = -1;
+         r = NULL;
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "cfg.section.open: '%s'\n", section);
 
-      if ((*skip == '/' && *skip+1 == '/') ||		// comments
-           *skip == '#' || *skip == ';') {
-         continue;
-      } else if (*skip == '[' && *end == ']') {		// section
-         // plug a memory leak
-         if (section != NULL) {
-            switch_safe_free(section);
+         if (strncasecmp(section, "radio", 5) == 0) {
+            sect = SECT_RADIO;
+
+            if (!isdigit((unsigned char)section[5])) {
+               switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Radio configuration has invalid [%s] section (parsing %s:%d)\n", section, file, tok.line);
+               errors++;
+               sect = SECT_SKIP;
+               continue;
+            }
+
+            radio = atoi(section + 5);
+         } else if (only_radio >= 0) {
+            // Only after one radio? skip everything else
+            sect = SECT_SKIP;
+            continue;
+         } else if (strcasecmp(section, "general") == 0) {
+            sect = SECT_GENERAL;
+         } else if (strncasecmp(section, "conference", 10) == 0) {
+            sect = SECT_CONFERENCE;
+         } else if (strcasecmp(section, "tones") == 0) {
+            sect = SECT_TONES;
+         } else {
+            switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Unknown configuration section '%s' at %s:%d\n", section, file, tok.line);
+            warnings++;
+            sect = SECT_UNKNOWN;
          }
 
-         section = strndup(skip + 1, strlen(skip) - 2);
-         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "cfg.section.open: '%s'\n", section);
+         if (sect != SECT_RADIO) {
+            continue;
+         }
+
+         if (only_radio >= 0 && radio != only_radio) {
+            sect = SECT_SKIP;
+            continue;
+         }
 
-         // Here we should initialize anything needed by a section
-         if (strcasecmp(section, "tones")) {
-            // Initialize the tone playback system
-            radio_tones_init();
+         // A radio added at runtime is allowed to grow the table
+         if (radio != only_radio && radio >= snap->settings->max_radios) {
+            switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Radio configuration [%s] section ignored since general:radios is only set to %d! (parsing %s:%d)\n", section, snap->settings->max_radios, file, tok.line);
+            sect = SECT_SKIP;
+            continue;
+         }
+
+         // Settings go into a staged copy, compared with (or copied to) the running radio later
+         if ((r = cfg_stage_radio(snap, radio)) == NULL) {
+            switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "error configuring radio%d - out of memory!\n", radio);
+            errors++;
+            sect = SECT_SKIP;
+            continue;
          }
+
+         snap->radios++;
          continue;
       }
 
       // Configuration data *MUST* be inside of a section, no exceptions.
-      if (!section) {
-         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "config %s:%d: line outside of section: %s\n", file, line, buf);
-         errors++;
+      if (sect == SECT_NONE) {
+         if (only_radio < 0) {
+            switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "config %s:%d:%d: line outside of section: %s=%s\n", file, tok.line, tok.col, tok.key, tok.val);
+            errors++;
+         }
          continue;
       }
 
-      // @END exits a section early
-      if (strcasecmp(skip, "@END") == 0) {
-         section = NULL;
+      if (sect == SECT_SKIP || sect == SECT_UNKNOWN) {
          continue;
       }
 
+      key = tok.key;
+      val = tok.val;
+
       ///////////////////////////////////
       // Handle configuration sections //
       ///////////////////////////////////
@@ -108,340 +220,337 @@ dict *dconf_load(const char *file) {
       ////////////////////////////////////
       // General Settings (dict backed) //
       ////////////////////////////////////
-      if (strcasecmp(section, "general") == 0) {
-         char *sep = strchr(skip, '=');
-
-         if (sep == NULL) {
-            switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Radio configuration [%s] invalid key '%s' missing separator (=) (parsing %s:%d)\n", section, skip, file, line);
-            continue;
-         }
-
-         // make sure you free this before returning/continuing!
-         key = strndup(skip, (sep - skip));
-         val = strndup(sep + 1, strlen(sep + 1));
-
-         // Store value in the dictionary (globals.cfg)
+      if (sect == SECT_GENERAL) {
+         // Store value in the dictionary (published as globals.cfg once applied)
          dict_add(cp, key, val);
+         stored++;
 
-         /////////////////////////////////////////
-         // Scan dict config and update globals //
-         /////////////////////////////////////////
-         // Here we scan the dict for changed configurations that need refreshed in the globals struct (stuff that doesnt change except at reload but is polled often)
-         int i;
-
-         // XXX: This needs to be improved in a way that will reflect changes to the dict contents via api....
-         if (strcasecmp(key, "max_radios") == 0) {
-            // Define max radios
-            if ((i = atoi(val)) > 0) {
-               globals.max_radios = i;
-            }
-         } else if (strcasecmp(key, "max_conferences") == 0) {
-            if ((i = atoi(val)) > 0) {
-               globals.max_conferences = i;
-            }
-         } else if (strcasecmp(key, "poll_interval") == 0) {
-            // Minimum poll time is 25ms
-            if ((i = atoi(val)) >= 25) {
-               globals.poll_interval = i;
-            } else if (i == 0) {
-               globals.poll_interval = 0;
-               switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "poll_interval is disabled (0), set it to >= 25 to enable polling throttling, if you find CPU usage is too high when idle!\n");
-            }
-         } else if (strcasecmp(key, "id_timeout") == 0) {
-            i = atoi(val);
-
-            // ID timeout should always be set for ham usage, send a warning if not
-            if (i <= 0) {
-               switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "id_timeout should have non-zero value for ham usage!\n");
-            } else {
-               globals.timeout_id = i;
-            }
-         } else if (strcasecmp(key, "id_type") == 0) {
-            if (strcasecmp(val, "none") == 0) {
-               switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "id_type should be set to voice or cw for ham usage.\n");
-               warnings++;
-               continue;
-            } else if (strcasecmp(val, "cw") == 0) {
-               globals.id_type = ID_CW;
-            } else if (strcasecmp(val, "voice") == 0) {
-               globals.id_type = ID_VOICE;
-            } else if (strcasecmp(val, "both") == 0) {
-               globals.id_type = ID_BOTH;
-            } else {
-               switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "id_type '%s' is not valid while parsing configuration\n", val);
-               errors++;
-            }
+         // Keys that are polled often are also kept in globals (see radio_cfg_keys.c), staged until applied; the rest only live in the dict
+         if ((k = radio_cfg_key(key, tok.key_len)) != NULL && k->scope == CFG_GENERAL &&
+             radio_cfg_apply_general(k, snap->settings, &tok, file) != SWITCH_STATUS_SUCCESS) {
+            errors++;
          }
 
-         // free some memory up
-         switch_safe_free(key);
-         switch_safe_free(val);
-
       /////////////////
       // Conferences //
       /////////////////
-      } else if (strncasecmp(section, "conference", 10) == 0) {
-         char *sep = strchr(skip, '=');
-         // make sure you free this!
-         key = strndup(skip, (sep - skip));
-         val = strndup(sep + 1, strlen(sep + 1));
-         // Conference config parser - XXX: Create a new conference struct and add to list...
-         if (strcasecmp(key, "radios") == 0) {
-         } else if (strcasecmp(key, "master_radio") == 0) {
-           // XXX:
-         } else if (strcasecmp(key, "admin_pin") == 0) {
-           // XXX:
-         } else if (strcasecmp(key, "listen_pin") == 0) {
-           // XXX:
+      } else if (sect == SECT_CONFERENCE) {
+         if (radio_conference_config(snap->conferences, atoi(section + 10), key, val) != SWITCH_STATUS_SUCCESS) {
+            switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Radio configuration [%s] bad value for %s (parsing %s:%d:%d)\n", section, key, file, tok.line, tok.val_col);
+            errors++;
          }
-         switch_safe_free(key);
-         switch_safe_free(val);
 
       //////////////
       // Tonesets //
       //////////////
-      } else if (strcasecmp(section, "tones") == 0) {
-         char *sep = strchr(skip, '=');
-         // make sure you free this!
-         key = strndup(skip, (sep - skip));
-         val = strndup(sep + 1, strlen(sep + 1));
-
-         // Store value in the dictionary (globals.tones)
-         dict_add(globals.radio_tones, key, val);
-
-         // Add to dictionary
-         switch_safe_free(key);
-         switch_safe_free(val);
+      } else if (sect == SECT_TONES) {
+         // Store value in the dictionary (globals.radio_tones once applied)
+         dict_add(snap->tones, key, val);
+         stored++;
 
       //////////////////////
       // Radio Interfaces //
       //////////////////////
-      } else if (strncasecmp(section, "radio", 5) == 0) {
-         int radio = -1;
-         char *radio_id_s = section + 5;
-         Radio_t *r = NULL;
-         char *sep = strchr(skip, '=');
-
-         if (sep == NULL) {
-            switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Radio configuration [%s] invalid key '%s' missing separator (=) (parsing %s:%d)\n", section, skip, file, line);
-            continue;
+      } else if (sect == SECT_RADIO) {
+         if ((k = radio_cfg_key(key, tok.key_len)) == NULL || k->scope == CFG_GENERAL) {
+            // hamradio.conf is shared with other programs, which may have keys of their own
+            switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "[cfg:radio%d] ignoring unknown key %s (parsing %s:%d:%d)\n", radio, key, file, tok.line, tok.col);
+         } else if (radio_cfg_apply(k, radio, r, &tok, file) != SWITCH_STATUS_SUCCESS) {
+            errors++;
          }
+      }
+   }
 
-         if (radio_id_s != NULL) {
-            radio = atoi(radio_id_s);
-         } else {
-            switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Radio configuration has invalid [radioX] section (parsing %s:%d)\n", file, line);
-         }
+   // Every value we kept is a copy (in a dict, or a radio), the file can go
+   switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "configuration loaded with %d errors and %d warnings from %s (%d lines, %lu bytes, %d values copied, %d radios) in %ld us\n",
+                     errors, warnings, file, lx.line, (unsigned long)lx.len, stored, snap->radios, (long)(switch_micro_time_now() - started));
+   cfg_lex_close(&lx);
 
-         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "configuring radio%d\n", radio);
+   return snap;
+}
 
-         if (radio < 0 || radio > globals.max_radios) {
-           switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Radio configuration [%s] section ignored since general:radios is only set to %d! (parsing %s:%d)\n", section, globals.max_radios, file, line);
-           continue;
-         }
+CfgSnapshot_t *dconf_load(const char *file) {
+   return dconf_parse(file, -1);
+}
 
-         // is this the first radio definition? if so, we must allocate the memory
-         if (globals.Radios == NULL)
-            switch_malloc(globals.Radios, sizeof(Radio_t) * globals.max_radios);
+void dconf_apply_general(CfgSnapshot_t *snap) {
+   if (snap->settings) {
+      radio_cfg_general_copy(snap->settings);
+   }
 
-         if ((r = &Radios(radio)) == NULL) {
-            switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "error bringing up radio%d - couldn't find memory structure!\n", radio);
-            continue;
-         }
+   if (snap->conferences) {
+      radio_conference_apply(snap->conferences);
+   }
 
-         // make sure you free this!
-         key = strndup(skip, (sep - skip));
-         val = strndup(sep + 1, strlen(sep + 1));
-
-//         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "[cfg:radio%d] setting %s - %s. (parsing '%s' at %s:%d)\n", radio, key, val, buf, file, line);
-
-         if (strcasecmp(key, "enabled") == 0) {
-           if (!strcasecmp(val, "true") || !strcasecmp(val, "yes") || !strcasecmp(val, "on")) {
-              r->enabled = true;
-           } else {
-              r->enabled = false;
-           }
-         } else if (strcasecmp(key, "cat_type") == 0) {
-            if (strcasecmp(val, "hamlib") == 0) {
-              r->CAT_mode = CAT_TYPE_HAMLIB;
-            } else if (strcasecmp(val, "rawserial") == 0) {
-              r->CAT_mode = CAT_TYPE_RAWSERIAL;
+   if (snap->tones) {
+      radio_tones_set(snap->tones);
+      snap->tones = NULL;
+   }
+
+   // Anyone still holding the old snapshot keeps it until they're done
+   dconf_publish(snap->general);
+   snap->general = NULL;
+}
+
+Radio_t *dconf_staged(CfgSnapshot_t *snap, const int radio) {
+   return ((radio >= 0 && radio < RADIO_TABLE_MAX && snap->radio[radio]) ? &snap->radio[radio]->hot : NULL);
+}
+
+switch_bool_t dconf_radio_changed(CfgSnapshot_t *snap, const int radio) {
+   Radio_t *staged = dconf_staged(snap, radio);
+
+   if (staged == NULL) {
+      return false;
+   }
+
+   return (!radio_exists(radio) || radio_cfg_radio_differs(&Radios(radio), staged));
+}
+
+// Copy a staged radio into the table, creating its slot if needed. Table writers only (see radio_table.h)
+Radio_t *dconf_apply_radio(CfgSnapshot_t *snap, const int radio) {
+   Radio_t *staged = dconf_staged(snap, radio), *r;
+
+   if (staged == NULL) {
+      return NULL;
+   }
+
+   // (re)created if it was removed at runtime but is back in the config
+   if ((r = radio_table_slot(radio)) == NULL) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "error bringing up radio%d - couldn't find memory structure!\n", radio);
+      return NULL;
+   }
+
+   switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "configuring radio%d\n", radio);
+   radio_cfg_radio_copy(radio, r, staged);
+   return r;
+}
+
+// Parse a single radio's settings, for dconf_apply_radio() (general settings aren't read)
+CfgSnapshot_t *dconf_load_radio(const char *file, const int radio) {
+   CfgSnapshot_t *snap;
+
+   if (radio < 0 || radio >= RADIO_TABLE_MAX) {
+      return NULL;
+   }
+
+   if (!(snap = dconf_parse(file, radio))) {
+      return NULL;
+   }
+
+   if (dconf_staged(snap, radio) == NULL) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "no [radio%d] section found in %s\n", radio, file);
+      dconf_free(snap);
+      return NULL;
+   }
+
+   return snap;
+}
+
+////////////////////
+// Typed handles  //
+////////////////////
+#define	CFG_HANDLE(k, t, def, min, max)	{ k, t, def, min, max, (int64_t)(def), def }
+
+CfgHandle_t cfg_handles[CFGH_COUNT] = {
+   [CFGH_EVENT_TAP]		= CFG_HANDLE("event_tap",		CFGH_BOOL,	0,	0,	1),
+   [CFGH_EVENT_TAP_RATE]	= CFG_HANDLE("event_tap_rate",		CFGH_INT,	10,	1,	INT_MAX),
+   [CFGH_MLOCKALL]		= CFG_HANDLE("mlockall",		CFGH_BOOL,	0,	0,	1),
+   [CFGH_RT_PRIORITY]		= CFG_HANDLE("rt_priority",		CFGH_INT,	50,	0,	99),
+   [CFGH_RT_SELFTEST]		= CFG_HANDLE("rt_selftest",		CFGH_INT,	200,	0,	INT_MAX),
+   [CFGH_STATE_EVENT_WINDOW]	= CFG_HANDLE("state_event_window",	CFGH_MSECS,	250,	0,	INT_MAX),
+   [CFGH_TRACE_DRAIN_INTERVAL]	= CFG_HANDLE("trace_drain_interval",	CFGH_MSECS,	100,	1,	INT_MAX),
+   [CFGH_TRACE_DRAIN_MAX]	= CFG_HANDLE("trace_drain_max",		CFGH_INT,	256,	0,	INT_MAX),
+};
+
+switch_status_t dconf_parse_duration(const char *val, const uint64_t unit_ms, uint64_t *ms) {
+   char *end;
+   long long n;
+   uint64_t mult;
+
+   errno = 0;
+   n = strtoll(val, &end, 10);
+
+   if (end == val || errno == ERANGE || n < 0) {
+      return SWITCH_STATUS_FALSE;
+   }
+
+   while (*end == ' ' || *end == '\t') {
+      end++;
+   }
+
+   if (*end == '\0') {
+      mult = unit_ms;
+   } else if (strcasecmp(end, "ms") == 0) {
+      mult = 1;
+   } else if (strcasecmp(end, "s") == 0) {
+      mult = 1000;
+   } else if (strcasecmp(end, "m") == 0) {
+      mult = 60 * 1000;
+   } else if (strcasecmp(end, "h") == 0) {
+      mult = 3600 * 1000;
+   } else {
+      return SWITCH_STATUS_FALSE;
+   }
+
+   // Anything that doesn't fit is as wrong as a typo
+   if (mult != 0 && (uint64_t)n > UINT64_MAX / mult) {
+      return SWITCH_STATUS_FALSE;
+   }
+
+   *ms = (uint64_t)n * mult;
+   return SWITCH_STATUS_SUCCESS;
+}
+
+// Parse one handle's value from d, NULL (or a bad value) leaves the default
+static void dconf_resolve(const CfgHandle_t *h, dict *d, int64_t *i, double *dv) {
+   const char *val = (d ? dict_get(d, h->key, NULL) : NULL);
+   double v = h->def;
+   uint64_t ms;
+   char *end;
+   int b;
+
+   if (val != NULL) {
+      switch (h->type) {
+         case CFGH_BOOL:
+            if ((b = str_to_intbool(val)) < 0) {
+               b = (!strcasecmp(val, "yes") ? 1 : (!strcasecmp(val, "no") ? 0 : -1));
             }
-         } else if (strcasecmp(key, "cat_model") == 0) {
-            if (strcasecmp(val, "probe") == 0) {
-               // Set this to -1, so when we actually bring the radio up, we can see it's supposed tobe probed
-               r->rig_model = -1;
-            } else
-               r->rig_model = atoi(val);
-         } else if (strcasecmp(key, "cat_port") == 0) {
-            memset(r->rig_path, 0, PATH_MAX);
-            strncpy(r->rig_path, val, PATH_MAX);
-         } else if (strcasecmp(key, "description") == 0) {
-           char *qp = NULL, *ep = NULL;
-
-           memset(r->description, 0, sizeof(r->description));
-           if ((qp = strchr(val, '"')) != NULL) {
-              // If we can't find a second ", it is an error...
-              if ((ep = strrchr(qp, '"')) == NULL) {
-                 // cry about missing end-quote
-                 switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[config] Missing end-quote while trying to parse string in config at %s:%d\n", file, line);
-                 // XXX: abort loading
-              } else { // String is valid, copy it
-                if ((ep - qp) < sizeof(r->description)) {
-                   memcpy(r->description, qp + 1, (ep - qp) - 2);
-                } else {
-                   // cry that string is too big and truncate it...
-                   switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[radio%d] description too long (%lu bytes) and was truncated to %lu bytes!\n", radio, strlen(val), sizeof(r->description) - 1);
-                   memcpy(r->description, qp + 1, sizeof(r->description) - 1);
-                }
-              }
-           } else { // Not quoted
-              if (strlen(val) <= sizeof(r->description) - 1) {
-                 memcpy(r->description, val, strlen(val));
-              } else {
-                 // cry that the string is too big and truncate it...
-                 switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[radio%d] description too long (%lu bytes) and was truncated to %lu bytes!\n", radio, strlen(val), sizeof(r->description) - 1);
-                 memcpy(r->description, val, sizeof(r->description) - 1);
-              }
-           }
-         } else if (strcasecmp(key, "ctcss_inband") == 0) {
-           if (!strcasecmp(val, "true") || !strcasecmp(val, "yes") || !strcasecmp(val, "on")) {
-              r->ctcss_inband = true;
-           } else {
-              r->ctcss_inband = false;
-           }
-         } else if (strcasecmp(key, "gpio_power_invert") == 0) {
-           if (!strcasecmp(val, "true") || !strcasecmp(val, "yes") || !strcasecmp(val, "on")) {
-              r->pin_power_invert = true;
-           } else {
-              r->pin_power_invert = false;
-           }
-         } else if (strcasecmp(key, "gpio_power") == 0) {
-           int ival = atoi(val);
-
-           // Some people don't use power control, -1 is a valid setting to indicate 'disabled'...
-           if (ival == -1) {
-              switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "[cfg:radio%d] gpio power control disabled.\n", radio);
-           }
-
-           if (ival >= -1 && ival <= MAX_GPIO) {
-              r->pin_power = ival;
-           } else { 
-              switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[cfg:radio%d] Key %s has invalid value '%s'. (parsing '%s' at %s:%d)\n", radio, key, val, buf, file, line);
-           }
-         } else if (strcasecmp(key, "gpio_ptt_invert") == 0) {
-           if (!strcasecmp(val, "true") || !strcasecmp(val, "yes") || !strcasecmp(val, "on")) {
-              r->pin_ptt_invert = true;
-           } else {
-              r->pin_ptt_invert = false;
-           }
-         } else if (strcasecmp(key, "gpio_ptt") == 0) {
-           int ival = atoi(val);
-
-           if (ival == -1) {
-              switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "[cfg:radio%d] gpio ptt control disabled.\n", radio);
-           }
-
-           // Receivers won't have a PTT pin, -1 is valid setting to indicate 'disabled'...
-           if (ival >= -1 && ival <= MAX_GPIO) {
-              r->pin_ptt = ival;
-           } else { 
-              switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[cfg:radio%d] Key %s has invalid value '%s'. (parsing '%s' at %s:%d)\n", radio, key, val, buf, file, line);
-           }
-         } else if (strcasecmp(key, "gpio_squelch") == 0) {
-           int ival = atoi(val);
-
-           // Some devices don't have squelch output, -1 is a valid setting to indicate 'disabled'...
-           if (ival == -1) {
-              switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "[cfg:radio%d] gpio squlech input disabled.\n", radio);
-           } else if (ival >= -1 && ival <= MAX_GPIO) {
-              r->pin_squelch = ival;
-           } else { 
-              switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[cfg:radio%d] Key %s has invalid value '%s'. (parsing '%s' at %s:%d)\n", radio, key, val, buf, file, line);
-           }
-         } else if (strcasecmp(key, "pa_indev") == 0) {
-           if (val != NULL) {
-              // Zero out the buffer then copy our setting in
-              memset(r->pa_indev, 0, sizeof(r->pa_indev));
-              memcpy(r->pa_indev, val, (strlen(val) > (PATH_MAX - 1)) ? strlen(val) : PATH_MAX - 1);
-           }
-         } else if (strcasecmp(key, "pa_outdev") == 0) {
-           if (val != NULL) {
-              // Zero out the buffer then copy our setting in
-              memset(r->pa_outdev, 0, sizeof(r->pa_outdev));
-              memcpy(r->pa_outdev, val, (strlen(val) > (PATH_MAX - 1)) ? strlen(val) : PATH_MAX - 1);
-           }
-         } else if (strcasecmp(key, "squelch_mode") == 0) {
-           if (!strcasecmp(val, "gpio") == 0) {
-              r->RX_mode = SQUELCH_GPIO;
-           } else if (!strcasecmp(val, "vox") == 0) {
-              r->RX_mode = SQUELCH_VOX;
-           } else {
-              r->RX_mode = SQUELCH_MANUAL;
-           }
-         } else if (strcasecmp(key, "squelch_min") == 0) {
-             int i = atoi(val);
-
-             if (i > 0) {
-                r->squelch_min = i;
-             }
-         } else if (strcasecmp(key, "squelch_invert") == 0) {
-           if (!strcasecmp(val, "true") || !strcasecmp(val, "yes") || !strcasecmp(val, "on")) {
-              r->squelch_invert = true;
-           } else {
-              r->squelch_invert = false;
-           }
-         } else if (strcasecmp(key, "timeout_talk") == 0) {
-           int new_tot = 0;
-           new_tot = atoi(val);
-
-           if (new_tot > 0) {
-              switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "[%s] Set timeout_talk to %d\n", section, new_tot);
-              r->timeout_talk = new_tot;
-           } else {
-              switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[%s] Invalid timeout_talk value '%s' parsing '%s' at %s:%d\n", section, val, buf, file, line);
-              warnings++;
-           }
-         } else if (strcasecmp(key, "timeout_holdoff") == 0) {
-           int new_holdoff = 0;
-           new_holdoff = atoi(val);
-
-           if (new_holdoff > 0) {
-              switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "[%s] Set timeout_holdoff to %d\n", section, new_holdoff);
-              r->timeout_holdoff = new_holdoff;
-           } else {
-              switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[%s] Invalid timeout_penalty value '%s' parsing '%s' at %s:%d\n", section, val, buf, file, line);
-              warnings++;
-           }
-         }
-         switch_safe_free(key);
-         switch_safe_free(val);
-      } else {
-         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Unknown configuration section '%s' parsing '%s' at %s:%d\n", section, buf, file, line);
-         warnings++;
+            if (b >= 0) {
+               v = b;
+               val = NULL;
+            }
+            break;
+
+         case CFGH_INT:
+            v = strtol(val, &end, 0);
+            val = (end != val && *end == '\0' ? NULL : val);
+            break;
+
+         case CFGH_DOUBLE:
+            v = strtod(val, &end);
+            val = (end != val && *end == '\0' ? NULL : val);
+            break;
+
+         case CFGH_MSECS:
+            if (dconf_parse_duration(val, 1, &ms) == SWITCH_STATUS_SUCCESS) {
+               v = ms;
+               val = NULL;
+            }
+            break;
+      }
+
+      // Still set means it didn't parse
+      if (val != NULL || v < h->min || v > h->max) {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "[cfg] %s: invalid value '%s', using %g\n", h->key, dict_get(d, h->key, ""), h->def);
+         v = h->def;
       }
-   } while (!feof(fp));
+   }
 
-   switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "configuration loaded with %d errors and %d warnings from %s (%d lines)\n", errors, warnings, file, line);
-   fclose(fp);
+   *i = (int64_t)v;
+   *dv = v;
+}
 
-   // avoid leaking memory from switch_strdup above in section processing
-   if (section != NULL) {
-      switch_safe_free(section);
+/////////////////////////////////
+// Published [general] snapshot //
+/////////////////////////////////
+CfgGeneral_t *dconf_hold(void) {
+   int rcu = radio_rcu_read_lock();
+   CfgGeneral_t *c = dconf_current();
+
+   // A retired snapshot isn't released until every read section that might
+   // have loaded it is over, so it can't be freed before we count ourselves in
+   if (c) {
+      __atomic_add_fetch(&c->refs, 1, __ATOMIC_RELAXED);
    }
 
-   return cp;
+   radio_rcu_read_unlock(rcu);
+   return c;
+}
+
+void dconf_release(CfgGeneral_t *c) {
+   if (c && __atomic_sub_fetch(&c->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+      dict_free(c->dict);
+      free(c);
+   }
+}
+
+// Drops the reference publishing held, once the grace period is over
+static void dconf_retired(void *ptr) {
+   dconf_release(ptr);
+}
+
+void dconf_publish(dict *d) {
+   static uint64_t version;
+   CfgGeneral_t *c = NULL, *old = dconf_current();
+   int64_t i[CFGH_COUNT];
+   double dv[CFGH_COUNT];
+
+   if (d && (c = malloc(sizeof(*c)))) {
+      c->refs = 1;
+      c->version = ++version;
+      c->dict = d;
+   } else if (d) {
+      dict_free(d);
+      return;
+   }
+
+   // Handles follow the snapshot (back to their defaults when there's none),
+   // parsed into it before anyone can see it
+   for (int h = 0; h < CFGH_COUNT; h++) {
+      dconf_resolve(&cfg_handles[h], d, (c ? &c->i[h] : &i[h]), (c ? &c->d[h] : &dv[h]));
+   }
+
+   __atomic_store_n(&globals.cfg, c, __ATOMIC_RELEASE);
+
+   // Then the single-load copies, see dconf_int()
+   for (int h = 0; h < CFGH_COUNT; h++) {
+      __atomic_store_n(&cfg_handles[h].i, (c ? c->i[h] : i[h]), __ATOMIC_RELAXED);
+      __atomic_store(&cfg_handles[h].d, (c ? &c->d[h] : &dv[h]), __ATOMIC_RELAXED);
+   }
+
+   if (old) {
+      radio_rcu_retire_fn(old, dconf_retired);
+   }
+}
+
+// Copy of the current settings, less one key, for dconf_set()/dconf_unset()
+static dict *dconf_copy(const char *without) {
+   CfgGeneral_t *c = dconf_current();
+   const char *key, *val;
+   time_t ts;
+   dict *d = dict_new();
+
+   if (c == NULL || d == NULL) {
+      return d;
+   }
+
+   for (int rank = dict_enumerate(c->dict, 0, &key, &val, &ts); rank >= 0; rank = dict_enumerate(c->dict, rank, &key, &val, &ts)) {
+      if (strcmp(key, without) != 0) {
+         dict_add(d, key, val);
+      }
+   }
+
+   return d;
+}
+
+const char *dconf_str(CfgGeneral_t *c, const char *key, const char *def) {
+   if (c == NULL || key == NULL) {
+      return def;
+   }
+
+   return dict_get(c->dict, key, def);
 }
 
 ///////////////////////////////////////////////////////////////////////////
 // Functions for accessing dictionary contents, in the desired data type //
 ///////////////////////////////////////////////////////////////////////////
 int dconf_get_bool(const char *key, const int def) {
-   char       *tmp;
+   CfgGeneral_t *c = dconf_hold();
+   const char *tmp;
    int         rv = 0;
 
-   if ((tmp = dconf_get_str(key, NULL)) == NULL) {
-      return def;
+   if ((tmp = dconf_str(c, key, NULL)) == NULL) {
+      rv = def;
    } else if (strcasecmp(tmp, "true") == 0 || strcasecmp(tmp, "on") == 0 ||
             strcasecmp(tmp, "yes") == 0 || (int)strtol(tmp, NULL, 0) == 1) {
       rv = 1;
@@ -450,41 +559,54 @@ int dconf_get_bool(const char *key, const int def) {
       rv = 0;
    }
 
+   dconf_release(c);
    return rv;
 }
 
 double dconf_get_double(const char *key, const double def) {
-   char       *tmp;
+   CfgGeneral_t *c = dconf_hold();
+   const char *tmp;
+   double      rv = def;
 
-   if ((tmp = dconf_get_str(key, NULL)) == NULL) {
-      return def;
+   if ((tmp = dconf_str(c, key, NULL)) != NULL) {
+      rv = atof(tmp);
    }
 
-   return atof(tmp);
+   dconf_release(c);
+   return rv;
 }
 
 int dconf_get_int(const char *key, const int def) {
-   char       *tmp;
+   CfgGeneral_t *c = dconf_hold();
+   const char *tmp;
+   int         rv = def;
 
-   if ((tmp = dconf_get_str(key, NULL)) == NULL) {
-      return def;
+   if ((tmp = dconf_str(c, key, NULL)) != NULL) {
+      rv = (int)strtol(tmp, NULL, 0);
    }
 
-   return (int)strtol(tmp, NULL, 0);
+   dconf_release(c);
+   return rv;
 }
 
-char       *dconf_get_str(const char *key, const char *def) {
-   if (_CONF_DICT == NULL || key == NULL) {
-      return NULL;
-   }
+// Writers only (hold globals.mutex): copy, change, publish
+int dconf_set(const char *key, const char *val) {
+   dict *d = dconf_copy(key);
+   int rv;
 
-   return (char *)dict_get(_CONF_DICT, key, def);
-}
+   if (d == NULL) {
+      return -1;
+   }
 
-int dconf_set(const char *key, const char *val) {
-   return dict_add(_CONF_DICT, key, val);
+   rv = dict_add(d, key, val);
+   dconf_publish(d);
+   return rv;
 }
 
 void dconf_unset(const char *key) {
-   dict_del(_CONF_DICT, key);
+   dict *d = dconf_copy(key);
+
+   if (d) {
+      dconf_publish(d);
+   }
 }
@@ -8,14 +8,153 @@
 #include <switch.h>
 #include "dict.h"
 
+// Typed handles for [general] keys, see dconf_int() below
+typedef enum CfgHandleType {
+   CFGH_INT = 0,
+   CFGH_BOOL,
+   CFGH_DOUBLE,
+   CFGH_MSECS				// a time (see dconf_parse_duration), bare numbers are ms
+} CfgHandleType_t;
+
+typedef enum CfgHandleId {
+   CFGH_EVENT_TAP = 0,
+   CFGH_EVENT_TAP_RATE,
+   CFGH_MLOCKALL,
+   CFGH_RT_PRIORITY,
+   CFGH_RT_SELFTEST,
+   CFGH_STATE_EVENT_WINDOW,
+   CFGH_TRACE_DRAIN_INTERVAL,
+   CFGH_TRACE_DRAIN_MAX,
+   CFGH_COUNT
+} CfgHandleId_t;
+
+//
+// The [general] settings, as an immutable snapshot. Once published in
+// globals.cfg a snapshot is never changed: a reload (or dconf_set) builds a
+// new one and publishes it, and the old one is freed once the last reader
+// has let go of it. Reading needs no lock, just a reference:
+//
+//	CfgGeneral_t *c = dconf_hold();
+//	... dconf_str(c, "key", def) ...
+//	dconf_release(c);
+//
+// dconf_get_int() and friends do that for a single value. Strings point
+// into the snapshot, so they're only good while it's held.
+//
+struct CfgGeneral {
+   uint32_t	refs;			// one while published, plus one per holder
+   uint64_t	version;		// bumped for every snapshot published
+   dict		*dict;			// read only
+   int64_t	i[CFGH_COUNT];		// typed handles, parsed from dict before it's published
+   double	d[CFGH_COUNT];
+};
+typedef struct CfgGeneral CfgGeneral_t;
+
+#define	dconf_current()		__atomic_load_n(&globals.cfg, __ATOMIC_ACQUIRE)
+
+extern CfgGeneral_t *dconf_hold(void);
+extern void dconf_release(CfgGeneral_t *c);
+extern const char *dconf_str(CfgGeneral_t *c, const char *key, const char *def);
+
+// Writers only (hold globals.mutex): d becomes the current snapshot (NULL for
+// none), the old one is retired and freed by radio_rcu_reclaim()
+extern void dconf_publish(dict *d);
+
+//
+// Typed handles for the [general] keys that only live in the dictionary (the
+// ones in radio_cfg_keys.c are parsed straight into globals). Each is parsed
+// once, when a snapshot is published, so reading one is a single load with
+// no hashing or strtol:
+//
+//	if (dconf_bool(CFGH_EVENT_TAP)) ...
+//
+// A missing, unparsable or out of range value gets the default (and a warning).
+//
+// The handles are updated one at a time, just after a new snapshot is
+// published, so during a reload two handles read back to back may come from
+// different snapshots. Code that needs several settings to agree (with each
+// other, or with strings from the same snapshot) reads them from a snapshot it
+// holds, with dconf_held_int() and dconf_held_double().
+//
+struct CfgHandle {
+   const char	*key;
+   CfgHandleType_t type;
+   double	def;			// whole numbers for everything but CFGH_DOUBLE
+   double	min, max;
+   int64_t	i;			// current value: CFGH_INT, CFGH_BOOL, CFGH_MSECS (ms)
+   double	d;			// ... CFGH_DOUBLE
+};
+typedef struct CfgHandle CfgHandle_t;
+
+extern CfgHandle_t cfg_handles[CFGH_COUNT];
+
+#define	dconf_int(h)		__atomic_load_n(&cfg_handles[(h)].i, __ATOMIC_RELAXED)
+#define	dconf_bool(h)		((switch_bool_t)dconf_int(h))
+#define	dconf_msecs(h)		dconf_int(h)
+
+static inline double dconf_double(const CfgHandleId_t h) {
+   double d;
+
+   __atomic_load(&cfg_handles[h].d, &d, __ATOMIC_RELAXED);
+   return d;
+}
+
+static inline int64_t dconf_held_int(const CfgGeneral_t *c, const CfgHandleId_t h) {
+   return (c ? c->i[h] : (int64_t)cfg_handles[h].def);
+}
+
+static inline double dconf_held_double(const CfgGeneral_t *c, const CfgHandleId_t h) {
+   return (c ? c->d[h] : cfg_handles[h].def);
+}
+
+// A time: a whole number, optionally followed by ms, s, m or h. A bare number is in unit_ms
+extern switch_status_t dconf_parse_duration(const char *val, const uint64_t unit_ms, uint64_t *ms);
+
+// Rarely read keys, looked up (and parsed) every call
 extern int  dconf_get_bool(const char *key, const int def);
 extern double dconf_get_double(const char *key, const double def);
 extern int  dconf_get_int(const char *key, const int def);
-extern char *dconf_get_str(const char *key, const char *def);
 extern int  dconf_set(const char *key, const char *val);
 extern void dconf_unset(const char *key);
-extern dict *dconf_load(const char *file);
 
-#define	_CONF_DICT globals.cfg
+//
+// A parsed hamradio.conf, not applied yet. Nothing running is touched until
+// dconf_apply_general() and dconf_apply_radio(): [general] has been read into
+// general (and the keys kept in globals into settings), [conferenceN] and
+// [tones] are staged whole, and [radioN] sections are staged so a reload can
+// compare them with the running radios and only touch the ones that changed.
+//
+struct CfgRadio;
+struct Radio;
+struct Globals;
+struct Conference;
+
+struct CfgSnapshot {
+   dict		*general;		// handed to dconf_publish() when applied
+   struct Globals *settings;		// [general] keys kept in globals (see radio_cfg_keys.c), the rest as they were
+   struct Conference *conferences;	// CONFERENCE_MAX
+   dict		*tones;
+   struct CfgRadio **radio;		// RADIO_TABLE_MAX, NULL where there's no section
+   int		radios;			// sections seen
+};
+typedef struct CfgSnapshot CfgSnapshot_t;
+
+extern CfgSnapshot_t *dconf_load(const char *file);
+
+// Just the [radioN] section for one radio, NULL if it isn't there (or doesn't parse)
+extern CfgSnapshot_t *dconf_load_radio(const char *file, const int radio);
+extern void dconf_free(CfgSnapshot_t *snap);
+
+// Publish [general] and put the staged settings, conferences and tones in place. Table writers only (see radio_table.h)
+extern void dconf_apply_general(CfgSnapshot_t *snap);
+
+// Staged settings for a radio, NULL if the file has no [radioN] for it
+extern struct Radio *dconf_staged(CfgSnapshot_t *snap, const int radio);
+
+// Is the radio in the file, and new or different from the one running?
+extern switch_bool_t dconf_radio_changed(CfgSnapshot_t *snap, const int radio);
+
+// Copy the staged settings into the radio table (creating the radio if needed)
+extern struct Radio *dconf_apply_radio(CfgSnapshot_t *snap, const int radio);
 
 #endif                                 /* !defined(__CONFIG_H) */
@@ -0,0 +1,595 @@
+/*
+ * Configuration keys: the table, its perfect hash, and parsing/formatting by type
+ */
+#include <ctype.h>
+#include <stddef.h>
+#include <limits.h>
+#include <pthread.h>
+#include <switch.h>
+#include "mod_hamradio.h"
+
+#define	GENERAL(f)	CFG_GENERAL, offsetof(Globals_t, f), sizeof(((Globals_t *)0)->f)
+#define	HOT(f)		CFG_RADIO, offsetof(Radio_t, f), sizeof(((Radio_t *)0)->f)
+#define	COLD(f)		CFG_COLD, offsetof(RadioCold_t, f), sizeof(((RadioCold_t *)0)->f)
+
+static const char *const id_types[] = { "none", "cw", "voice", "both", NULL };
+static const char *const cat_types[] = { "none", "hamlib", "rawserial", NULL };
+static const char *const squelch_modes[] = { "manual", "gpio", "vox", NULL };
+
+static switch_status_t parse_max_radios(const CfgKey_t *k, const int radio, void *field, const CfgTok_t *tok, const char *file);
+static switch_status_t parse_description(const CfgKey_t *k, const int radio, void *field, const CfgTok_t *tok, const char *file);
+static switch_status_t parse_duty_cycle(const CfgKey_t *k, const int radio, void *field, const CfgTok_t *tok, const char *file);
+static switch_status_t parse_duty_window(const CfgKey_t *k, const int radio, void *field, const CfgTok_t *tok, const char *file);
+static switch_status_t valid_poll_interval(const CfgKey_t *k, const int radio, const long val);
+static switch_status_t valid_id_type(const CfgKey_t *k, const int radio, const long val);
+static switch_status_t valid_gpio(const CfgKey_t *k, const int radio, const long val);
+static void format_description(const CfgKey_t *k, const void *field, char *buf, const size_t len);
+static void format_duty_window(const CfgKey_t *k, const void *field, char *buf, const size_t len);
+#if	!defined(NO_HAMLIB)
+static switch_status_t parse_cat_model(const CfgKey_t *k, const int radio, void *field, const CfgTok_t *tok, const char *file);
+static void format_cat_model(const CfgKey_t *k, const void *field, char *buf, const size_t len);
+#endif
+
+static const CfgKey_t cfg_keys[] = {
+   // name			type		where				min	max		names		parse			valid			format
+   { "max_radios",		CFG_INT,	GENERAL(max_radios),		1,	INT_MAX,	NULL,		parse_max_radios,	NULL,			NULL },
+   { "max_conferences",		CFG_INT,	GENERAL(max_conferences),	1,	INT_MAX,	NULL,		NULL,			NULL,			NULL },
+   { "poll_interval",		CFG_MSECS,	GENERAL(poll_interval),		0,	INT_MAX,	NULL,		NULL,			valid_poll_interval,	NULL },
+   { "id_timeout",		CFG_SECS,	GENERAL(timeout_id),		1,	INT_MAX,	NULL,		NULL,			NULL,			NULL },
+   { "id_type",			CFG_ENUM,	GENERAL(id_type),		0,	0,		id_types,	NULL,			valid_id_type,		NULL },
+
+   { "enabled",			CFG_BOOL,	HOT(enabled),			0,	0,		NULL,		NULL,			NULL,			NULL },
+   { "description",		CFG_STR,	COLD(description),		0,	0,		NULL,		parse_description,	NULL,			format_description },
+   { "cat_type",		CFG_ENUM,	COLD(CAT_mode),			0,	0,		cat_types,	NULL,			NULL,			NULL },
+#if	!defined(NO_HAMLIB)
+   { "cat_model",		CFG_INT,	COLD(rig_model),		-1,	INT_MAX,	NULL,		parse_cat_model,	NULL,			format_cat_model },
+   { "cat_port",		CFG_STR,	COLD(rig_path),			0,	0,		NULL,		NULL,			NULL,			NULL },
+#endif
+   { "ctcss_inband",		CFG_BOOL,	COLD(ctcss_inband),		0,	0,		NULL,		NULL,			NULL,			NULL },
+   { "gpio_power",		CFG_INT,	HOT(pin_power),			-1,	MAX_GPIO,	NULL,		NULL,			valid_gpio,		NULL },
+   { "gpio_power_invert",	CFG_BOOL,	HOT(pin_power_invert),		0,	0,		NULL,		NULL,			NULL,			NULL },
+   { "gpio_ptt",		CFG_INT,	HOT(pin_ptt),			-1,	MAX_GPIO,	NULL,		NULL,			valid_gpio,		NULL },
+   { "gpio_ptt_invert",		CFG_BOOL,	HOT(pin_ptt_invert),		0,	0,		NULL,		NULL,			NULL,			NULL },
+   { "gpio_squelch",		CFG_INT,	HOT(pin_squelch),		-1,	MAX_GPIO,	NULL,		NULL,			valid_gpio,		NULL },
+   { "pa_indev",		CFG_STR,	COLD(pa_indev),			0,	0,		NULL,		NULL,			NULL,			NULL },
+   { "pa_outdev",		CFG_STR,	COLD(pa_outdev),		0,	0,		NULL,		NULL,			NULL,			NULL },
+   { "squelch_mode",		CFG_ENUM,	HOT(RX_mode),			0,	0,		squelch_modes,	NULL,			NULL,			NULL },
+   { "squelch_invert",		CFG_BOOL,	HOT(squelch_invert),		0,	0,		NULL,		NULL,			NULL,			NULL },
+   { "squelch_min",		CFG_INT,	COLD(squelch_min),		1,	INT_MAX,	NULL,		NULL,			NULL,			NULL },
+   { "squelch_open_delay",	CFG_MSECS,	HOT(squelch.open_delay),	0,	INT_MAX,	NULL,		NULL,			NULL,			NULL },
+   { "squelch_close_delay",	CFG_MSECS,	HOT(squelch.close_delay),	0,	INT_MAX,	NULL,		NULL,			NULL,			NULL },
+   { "squelch_min_hold",	CFG_MSECS,	HOT(squelch.min_hold),		0,	INT_MAX,	NULL,		NULL,			NULL,			NULL },
+   { "timeout_talk",		CFG_SECS,	HOT(timeout_talk),		1,	INT_MAX,	NULL,		NULL,			NULL,			NULL },
+   { "timeout_holdoff",		CFG_SECS,	HOT(timeout_holdoff),		1,	INT_MAX,	NULL,		NULL,			NULL,			NULL },
+   { "duty_cycle",		CFG_INT,	COLD(duty.pct),			0,	100,		NULL,		parse_duty_cycle,	NULL,			NULL },
+   { "duty_window",		CFG_INT,	COLD(duty.window_ms),		1,	LONG_MAX,	NULL,		parse_duty_window,	NULL,			format_duty_window },
+};
+#define	CFG_KEYS	(sizeof(cfg_keys) / sizeof(cfg_keys[0]))
+
+//////////////////
+// Perfect hash //
+//////////////////
+#define	CFG_HASH_SIZE	128		// power of two, keep it >= 2 * CFG_KEYS or seeds get hard to find
+
+static struct {
+   uint32_t	seed;
+   int16_t	slot[CFG_HASH_SIZE];	// index into cfg_keys, -1 if empty
+} cfg_hash;
+static pthread_once_t cfg_hash_once = PTHREAD_ONCE_INIT;
+
+// FNV-1a over the lowercased name
+static inline uint32_t cfg_key_hash(const char *name, const size_t len, const uint32_t seed) {
+   uint32_t h = 2166136261U ^ seed;
+
+   for (size_t i = 0; i < len; i++) {
+      h ^= (uint8_t)tolower((unsigned char)name[i]);
+      h *= 16777619U;
+   }
+
+   return (h ^ (h >> 16)) & (CFG_HASH_SIZE - 1);
+}
+
+// Find a seed that puts every key in a slot of its own
+static void cfg_hash_build(void) {
+   for (uint32_t seed = 1; seed != 0; seed++) {
+      size_t i;
+
+      memset(cfg_hash.slot, 0xff, sizeof(cfg_hash.slot));
+
+      for (i = 0; i < CFG_KEYS; i++) {
+         uint32_t h = cfg_key_hash(cfg_keys[i].name, strlen(cfg_keys[i].name), seed);
+
+         if (cfg_hash.slot[h] >= 0) {
+            break;
+         }
+         cfg_hash.slot[h] = i;
+      }
+
+      if (i == CFG_KEYS) {
+         cfg_hash.seed = seed;
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "[cfg] %lu keys hashed into %d slots with seed %u\n", (unsigned long)CFG_KEYS, CFG_HASH_SIZE, seed);
+         return;
+      }
+   }
+}
+
+const CfgKey_t *radio_cfg_key(const char *name, const size_t len) {
+   const CfgKey_t *k;
+   int i;
+
+   pthread_once(&cfg_hash_once, cfg_hash_build);
+
+   if ((i = cfg_hash.slot[cfg_key_hash(name, len, cfg_hash.seed)]) < 0) {
+      return NULL;
+   }
+
+   k = &cfg_keys[i];
+   return ((strncasecmp(k->name, name, len) == 0 && k->name[len] == '\0') ? k : NULL);
+}
+
+const CfgKey_t *radio_cfg_key_at(const int i) {
+   return ((i >= 0 && i < (int)CFG_KEYS) ? &cfg_keys[i] : NULL);
+}
+
+//////////////////////
+// Values, by type  //
+//////////////////////
+static void *cfg_field(const CfgKey_t *k, Radio_t *r) {
+   switch (k->scope) {
+      case CFG_GENERAL:
+         return ((char *)&globals + k->offset);
+      case CFG_RADIO:
+         return ((char *)r + k->offset);
+      case CFG_COLD:
+         return ((char *)r->cold + k->offset);
+   }
+   return NULL;
+}
+
+// Integers (and enums and booleans) are whatever size the field is
+static void cfg_store_int(void *field, const size_t size, const long val) {
+   switch (size) {
+      case sizeof(int8_t):  *(int8_t *)field = val;  break;
+      case sizeof(int16_t): *(int16_t *)field = val; break;
+      case sizeof(int32_t): *(int32_t *)field = val; break;
+      case sizeof(int64_t): *(int64_t *)field = val; break;
+   }
+}
+
+static long cfg_load_int(const void *field, const size_t size) {
+   switch (size) {
+      case sizeof(int8_t):  return *(const int8_t *)field;
+      case sizeof(int16_t): return *(const int16_t *)field;
+      case sizeof(int32_t): return *(const int32_t *)field;
+      case sizeof(int64_t): return *(const int64_t *)field;
+   }
+   return 0;
+}
+
+static switch_status_t cfg_bad_value(const CfgKey_t *k, const CfgTok_t *tok, const char *file, const char *why) {
+   switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "config %s:%d:%d: %s: invalid value '%s' (%s)\n", file, tok->line, tok->val_col, k->name, tok->val, why);
+   return SWITCH_STATUS_FALSE;
+}
+
+static switch_status_t cfg_check_range(const CfgKey_t *k, const CfgTok_t *tok, const char *file, const long val) {
+   if (val < k->min || val > k->max) {
+      char why[64];
+
+      snprintf(why, sizeof(why), "must be %ld to %ld", k->min, k->max);
+      return cfg_bad_value(k, tok, file, why);
+   }
+
+   return SWITCH_STATUS_SUCCESS;
+}
+
+// Leading number, like atoi() always allowed, but there has to be one
+static switch_status_t cfg_parse_long(const CfgKey_t *k, const CfgTok_t *tok, const char *file, long *val) {
+   char *end;
+
+   errno = 0;
+   *val = strtol(tok->val, &end, 0);
+
+   if (end == tok->val || errno == ERANGE) {
+      return cfg_bad_value(k, tok, file, "not a number");
+   }
+
+   return cfg_check_range(k, tok, file, *val);
+}
+
+// A time with an optional unit (see dconf_parse_duration), in the field's own unit
+static switch_status_t cfg_parse_time(const CfgKey_t *k, const CfgTok_t *tok, const char *file, long *val) {
+   const uint64_t unit = (k->type == CFG_SECS ? 1000 : 1);
+   uint64_t ms;
+
+   if (dconf_parse_duration(tok->val, unit, &ms) != SWITCH_STATUS_SUCCESS) {
+      return cfg_bad_value(k, tok, file, (k->type == CFG_SECS ? "expected a time like 120, 120s, 2m or 1h" : "expected a time like 250, 250ms or 2s"));
+   }
+
+   if (ms % unit) {
+      return cfg_bad_value(k, tok, file, "not a whole number of seconds");
+   }
+
+   if (ms / unit > LONG_MAX) {
+      return cfg_bad_value(k, tok, file, "too long");
+   }
+
+   *val = ms / unit;
+   return cfg_check_range(k, tok, file, *val);
+}
+
+// Copy into a fixed size field, complaining (not silently) if it doesn't fit
+static void cfg_copy(const CfgKey_t *k, char *dst, const char *val, const size_t len, const CfgTok_t *tok, const char *file) {
+   size_t n = len;
+
+   if (n >= k->size) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "%s too long (%lu bytes) and was truncated to %lu bytes! (parsing %s:%d:%d)\n", k->name, (unsigned long)len, (unsigned long)(k->size - 1), file, tok->line, tok->val_col);
+      n = k->size - 1;
+   }
+
+   memcpy(dst, val, n);
+   dst[n] = '\0';
+}
+
+static switch_status_t cfg_apply_field(const CfgKey_t *k, const int radio, void *field, const CfgTok_t *tok, const char *file) {
+   long val = 0;
+   int b;
+
+   if (k->parse) {
+      return k->parse(k, radio, field, tok, file);
+   }
+
+   switch (k->type) {
+      case CFG_BOOL:
+         if ((b = str_to_intbool(tok->val)) < 0) {
+            if (!strcasecmp(tok->val, "yes")) {
+               b = 1;
+            } else if (!strcasecmp(tok->val, "no")) {
+               b = 0;
+            } else {
+               return cfg_bad_value(k, tok, file, "not true/false");
+            }
+         }
+         cfg_store_int(field, k->size, b);
+         return SWITCH_STATUS_SUCCESS;
+
+      case CFG_INT:
+         if (cfg_parse_long(k, tok, file, &val) != SWITCH_STATUS_SUCCESS) {
+            return SWITCH_STATUS_FALSE;
+         }
+         break;
+
+      case CFG_SECS:
+      case CFG_MSECS:
+         if (cfg_parse_time(k, tok, file, &val) != SWITCH_STATUS_SUCCESS) {
+            return SWITCH_STATUS_FALSE;
+         }
+         break;
+
+      case CFG_ENUM:
+         for (val = 0; k->names[val] && strcasecmp(k->names[val], tok->val); val++);
+
+         if (k->names[val] == NULL) {
+            return cfg_bad_value(k, tok, file, "unknown name");
+         }
+         break;
+
+      case CFG_STR:
+         cfg_copy(k, field, tok->val, tok->val_len, tok, file);
+         return SWITCH_STATUS_SUCCESS;
+   }
+
+   if (k->valid && k->valid(k, radio, val) != SWITCH_STATUS_SUCCESS) {
+      return SWITCH_STATUS_FALSE;
+   }
+
+   cfg_store_int(field, k->size, val);
+   return SWITCH_STATUS_SUCCESS;
+}
+
+switch_status_t radio_cfg_apply(const CfgKey_t *k, const int radio, Radio_t *r, const CfgTok_t *tok, const char *file) {
+   if (k->scope != CFG_GENERAL && r == NULL) {
+      return SWITCH_STATUS_FALSE;
+   }
+
+   return cfg_apply_field(k, radio, cfg_field(k, r), tok, file);
+}
+
+switch_status_t radio_cfg_apply_general(const CfgKey_t *k, Globals_t *g, const CfgTok_t *tok, const char *file) {
+   if (k->scope != CFG_GENERAL) {
+      return SWITCH_STATUS_FALSE;
+   }
+
+   return cfg_apply_field(k, -1, (char *)g + k->offset, tok, file);
+}
+
+void radio_cfg_format(const CfgKey_t *k, Radio_t *r, char *buf, const size_t len) {
+   const void *field;
+   long val;
+
+   if (k->scope != CFG_GENERAL && r == NULL) {
+      snprintf(buf, len, "%s", "");
+      return;
+   }
+
+   field = cfg_field(k, r);
+
+   if (k->format) {
+      k->format(k, field, buf, len);
+      return;
+   }
+
+   switch (k->type) {
+      case CFG_STR:
+         snprintf(buf, len, "%s", (const char *)field);
+         break;
+      case CFG_BOOL:
+         snprintf(buf, len, "%s", (cfg_load_int(field, k->size) ? "true" : "false"));
+         break;
+      case CFG_INT:
+         snprintf(buf, len, "%ld", cfg_load_int(field, k->size));
+         break;
+      case CFG_SECS:
+         // Written in the largest unit that divides it evenly
+         val = cfg_load_int(field, k->size);
+
+         if (val != 0 && val % 3600 == 0) {
+            snprintf(buf, len, "%ldh", val / 3600);
+         } else if (val != 0 && val % 60 == 0) {
+            snprintf(buf, len, "%ldm", val / 60);
+         } else {
+            snprintf(buf, len, "%lds", val);
+         }
+         break;
+      case CFG_MSECS:
+         snprintf(buf, len, "%ldms", cfg_load_int(field, k->size));
+         break;
+      case CFG_ENUM:
+         val = cfg_load_int(field, k->size);
+
+         // Only a name we can read back in again
+         for (int i = 0; k->names[i]; i++) {
+            if (i == val) {
+               snprintf(buf, len, "%s", k->names[i]);
+               return;
+            }
+         }
+         snprintf(buf, len, "%ld", val);
+         break;
+   }
+}
+
+void radio_cfg_export(switch_stream_handle_t *stream, const int radio) {
+   char buf[PATH_MAX + 3];
+   const char *key, *val;
+   CfgGeneral_t *cfg;
+   time_t ts;
+
+   // [general] is kept as it was read (it holds more than the table knows about)
+   if (radio < 0 && (cfg = dconf_hold())) {
+      stream->write_function(stream, "[general]\n");
+
+      for (int rank = dict_enumerate(cfg->dict, 0, &key, &val, &ts); rank >= 0; rank = dict_enumerate(cfg->dict, rank, &key, &val, &ts)) {
+         stream->write_function(stream, "%s=%s\n", key, val);
+      }
+      stream->write_function(stream, "\n");
+      dconf_release(cfg);
+   }
+
+   for (int i = 0; i < globals.max_radios; i++) {
+      if (!radio_exists(i) || (radio >= 0 && i != radio)) {
+         continue;
+      }
+
+      stream->write_function(stream, "[radio%d]\n", i);
+
+      for (size_t n = 0; n < CFG_KEYS; n++) {
+         if (cfg_keys[n].scope == CFG_GENERAL) {
+            continue;
+         }
+
+         // Numbers that were never set (out of range) would only be refused if read back in
+         if (cfg_keys[n].type == CFG_INT || cfg_keys[n].type == CFG_SECS || cfg_keys[n].type == CFG_MSECS) {
+            long val = cfg_load_int(cfg_field(&cfg_keys[n], &Radios(i)), cfg_keys[n].size);
+
+            if (val < cfg_keys[n].min || val > cfg_keys[n].max) {
+               continue;
+            }
+         }
+
+         radio_cfg_format(&cfg_keys[n], &Radios(i), buf, sizeof(buf));
+         stream->write_function(stream, "%s=%s\n", cfg_keys[n].name, buf);
+      }
+      stream->write_function(stream, "\n");
+   }
+}
+
+switch_bool_t radio_cfg_radio_differs(Radio_t *a, Radio_t *b) {
+   for (size_t n = 0; n < CFG_KEYS; n++) {
+      const CfgKey_t *k = &cfg_keys[n];
+      const void *fa, *fb;
+
+      if (k->scope == CFG_GENERAL) {
+         continue;
+      }
+
+      fa = cfg_field(k, a);
+      fb = cfg_field(k, b);
+
+      // Whatever is past the NUL is left over from an older value
+      if ((k->type == CFG_STR ? strncmp(fa, fb, k->size) : memcmp(fa, fb, k->size)) != 0) {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+void radio_cfg_radio_copy(const int radio, Radio_t *dst, Radio_t *src) {
+   radio_state_write_begin(dst);
+
+   for (size_t n = 0; n < CFG_KEYS; n++) {
+      const CfgKey_t *k = &cfg_keys[n];
+
+      // The duty cycle bucket only changes through radio_duty_configure(), below
+      if (k->scope == CFG_GENERAL || k->parse == parse_duty_cycle || k->parse == parse_duty_window) {
+         continue;
+      }
+
+      memcpy(cfg_field(k, dst), cfg_field(k, src), k->size);
+   }
+
+   radio_state_write_end(dst);
+   radio_duty_configure(radio, src->cold->duty.pct, src->cold->duty.window_ms);
+}
+
+void radio_cfg_general_copy(const Globals_t *src) {
+   for (size_t n = 0; n < CFG_KEYS; n++) {
+      const CfgKey_t *k = &cfg_keys[n];
+
+      if (k->scope != CFG_GENERAL) {
+         continue;
+      }
+
+      // Read without the lock by every loop over the table, and it only ever grows
+      if (k->parse == parse_max_radios) {
+         if (src->max_radios > globals.max_radios) {
+            __atomic_store_n(&globals.max_radios, src->max_radios, __ATOMIC_RELEASE);
+         }
+         continue;
+      }
+
+      memcpy((char *)&globals + k->offset, (const char *)src + k->offset, k->size);
+   }
+}
+
+///////////////////////////////////////
+// Keys that need more than the type //
+///////////////////////////////////////
+// The radio table can grow at runtime, but never shrinks on reload
+static switch_status_t parse_max_radios(const CfgKey_t *k, const int radio, void *field, const CfgTok_t *tok, const char *file) {
+   long val;
+
+   if (cfg_parse_long(k, tok, file, &val) != SWITCH_STATUS_SUCCESS) {
+      return SWITCH_STATUS_FALSE;
+   }
+
+   if (val > RADIO_TABLE_MAX) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "max_radios %ld is too large, using %d\n", val, RADIO_TABLE_MAX);
+      val = RADIO_TABLE_MAX;
+   }
+
+   // field is the staged copy, which starts out at the running value
+   if (val > *(int *)field) {
+      *(int *)field = val;
+   }
+
+   return SWITCH_STATUS_SUCCESS;
+}
+
+// Quotes are optional, but if it opens with one it has to close with one
+static switch_status_t parse_description(const CfgKey_t *k, const int radio, void *field, const CfgTok_t *tok, const char *file) {
+   const char *val = tok->val;
+   size_t len = tok->val_len;
+
+   if (*val == '"') {
+      if (len < 2 || val[len - 1] != '"') {
+         return cfg_bad_value(k, tok, file, "missing end-quote");
+      }
+      val++;
+      len -= 2;
+   }
+
+   cfg_copy(k, field, val, len, tok, file);
+   return SWITCH_STATUS_SUCCESS;
+}
+
+static void format_description(const CfgKey_t *k, const void *field, char *buf, const size_t len) {
+   snprintf(buf, len, "\"%s\"", (const char *)field);
+}
+
+// Only stored here, the bucket is set up by radio_duty_configure() when the radio is applied
+static switch_status_t parse_duty_cycle(const CfgKey_t *k, const int radio, void *field, const CfgTok_t *tok, const char *file) {
+   RadioDuty_t *d = (RadioDuty_t *)((char *)field - offsetof(RadioDuty_t, pct));
+   long val;
+
+   if (cfg_parse_long(k, tok, file, &val) != SWITCH_STATUS_SUCCESS) {
+      return SWITCH_STATUS_FALSE;
+   }
+
+   // Same as radio_duty_configure() would keep, so an unchanged radio compares equal
+   d->pct = (val >= 100 ? 0 : val);
+
+   if (d->window_ms == 0) {
+      d->window_ms = 600 * 1000;
+   }
+
+   return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t parse_duty_window(const CfgKey_t *k, const int radio, void *field, const CfgTok_t *tok, const char *file) {
+   uint64_t ms = radio_duty_parse_window(tok->val);
+
+   if (ms == 0) {
+      return cfg_bad_value(k, tok, file, "expected a time like 600, 600s, 10m or 1h");
+   }
+
+   *(uint64_t *)field = ms;
+   return SWITCH_STATUS_SUCCESS;
+}
+
+static void format_duty_window(const CfgKey_t *k, const void *field, char *buf, const size_t len) {
+   snprintf(buf, len, "%lus", (unsigned long)(*(const uint64_t *)field / 1000));
+}
+
+// Minimum housekeeping interval is 25ms, squelch changes don't wait for it
+static switch_status_t valid_poll_interval(const CfgKey_t *k, const int radio, const long val) {
+   if (val == 0) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "poll_interval is 0, housekeeping will run once a second\n");
+   } else if (val < 25) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "poll_interval %ld is too short, it must be 0 or at least 25 ms\n", val);
+      return SWITCH_STATUS_FALSE;
+   }
+
+   return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t valid_id_type(const CfgKey_t *k, const int radio, const long val) {
+   if (val == ID_NONE) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "id_type should be set to voice or cw for ham usage.\n");
+   }
+
+   return SWITCH_STATUS_SUCCESS;
+}
+
+// Not every radio has every line, -1 is a valid setting to indicate 'disabled'...
+static switch_status_t valid_gpio(const CfgKey_t *k, const int radio, const long val) {
+   if (val == -1) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "[cfg:radio%d] %s disabled.\n", radio, k->name);
+   }
+
+   return SWITCH_STATUS_SUCCESS;
+}
+
+#if	!defined(NO_HAMLIB)
+// Set this to -1, so when we actually bring the radio up, we can see it's supposed to be probed
+static switch_status_t parse_cat_model(const CfgKey_t *k, const int radio, void *field, const CfgTok_t *tok, const char *file) {
+   long val = -1;
+
+   if (strcasecmp(tok->val, "probe") != 0 && cfg_parse_long(k, tok, file, &val) != SWITCH_STATUS_SUCCESS) {
+      return SWITCH_STATUS_FALSE;
+   }
+
+   cfg_store_int(field, k->size, val);
+   return SWITCH_STATUS_SUCCESS;
+}
+
+static void format_cat_model(const CfgKey_t *k, const void *field, char *buf, const size_t len) {
+   long val = cfg_load_int(field, k->size);
+
+   if (val == -1) {
+      snprintf(buf, len, "probe");
+   } else {
+      snprintf(buf, len, "%ld", val);
+   }
+}
+#endif
@@ -0,0 +1,84 @@
+#if	!defined(RADIO_CFG_KEYS_H)
+#define	RADIO_CFG_KEYS_H
+
+//
+// Configuration keys
+//
+// Every [general] and [radioN] key we understand is one line in the table
+// in radio_cfg_keys.c: its name, what kind of value it takes, where that
+// lands (offset into Globals_t, Radio_t or RadioCold_t) and, if the type's
+// own handling isn't enough, a parser and/or a validator. Loading, the
+// status dump and hamradio export all walk that one table, so a new key
+// only has to be added there.
+//
+// Lookups go through a perfect hash over the names (case-insensitive): the
+// seed is picked once, the first time it's needed, so no two keys share a
+// slot and a lookup is one hash and one compare.
+//
+typedef enum CfgKeyType {
+   CFG_BOOL = 0,			// true/yes/on/1 or false/no/off/0
+   CFG_INT,				// whole number, min..max
+   CFG_STR,				// copied into a char[size]
+   CFG_ENUM,				// one of names[], stored as its index
+   CFG_SECS,				// a time like 120, 120s, 2m or 1h, stored in seconds, min..max
+   CFG_MSECS				// a time like 250, 250ms or 2s, stored in ms, min..max
+} CfgKeyType_t;
+
+typedef enum CfgKeyScope {
+   CFG_GENERAL = 0,			// [general], offset into Globals_t
+   CFG_RADIO,				// [radioN], offset into Radio_t
+   CFG_COLD				// [radioN], offset into RadioCold_t
+} CfgKeyScope_t;
+
+struct CfgKey;
+struct Globals;
+typedef struct CfgKey CfgKey_t;
+
+// Replaces the type's own parsing (and storing). Log why before returning SWITCH_STATUS_FALSE
+typedef switch_status_t (*CfgParse_t)(const CfgKey_t *k, const int radio, void *field, const CfgTok_t *tok, const char *file);
+// Called with a parsed CFG_INT/CFG_ENUM value before it's stored, may refuse it (and log why)
+typedef switch_status_t (*CfgValid_t)(const CfgKey_t *k, const int radio, const long val);
+// Writes the current value the way it would appear in hamradio.conf
+typedef void (*CfgFormat_t)(const CfgKey_t *k, const void *field, char *buf, const size_t len);
+
+struct CfgKey {
+   const char	*name;
+   CfgKeyType_t	type;
+   CfgKeyScope_t scope;
+   size_t	offset;			// of the field, in the scope's structure
+   size_t	size;			// of the field
+   long		min, max;		// CFG_INT
+   const char	*const *names;		// CFG_ENUM, NULL terminated
+   CfgParse_t	parse;			// optional
+   CfgValid_t	valid;			// optional
+   CfgFormat_t	format;			// optional
+};
+
+// Look up a key by name, NULL if we don't know it
+extern const CfgKey_t *radio_cfg_key(const char *name, const size_t len);
+
+// Parse tok's value into the field for k. r is NULL for CFG_GENERAL
+extern switch_status_t radio_cfg_apply(const CfgKey_t *k, const int radio, Radio_t *r, const CfgTok_t *tok, const char *file);
+
+// Parse tok's value for a CFG_GENERAL key into a staged copy of globals
+extern switch_status_t radio_cfg_apply_general(const CfgKey_t *k, struct Globals *g, const CfgTok_t *tok, const char *file);
+
+// Copy every [general] key kept in globals from a staged copy. Table writers only (see radio_table.h)
+extern void radio_cfg_general_copy(const struct Globals *src);
+
+// Current value of a key, as it would be written in hamradio.conf
+extern void radio_cfg_format(const CfgKey_t *k, Radio_t *r, char *buf, const size_t len);
+
+// Does any [radioN] setting differ between two radios
+extern switch_bool_t radio_cfg_radio_differs(Radio_t *a, Radio_t *b);
+
+// Copy every [radioN] setting from src (staged) to dst (a radio in the table)
+extern void radio_cfg_radio_copy(const int radio, Radio_t *dst, Radio_t *src);
+
+// Walk the table: returns the i'th key, NULL past the end
+extern const CfgKey_t *radio_cfg_key_at(const int i);
+
+// Write [general] and every radio (radio < 0), or just [radioN], in hamradio.conf syntax
+extern void radio_cfg_export(switch_stream_handle_t *stream, const int radio);
+
+#endif	// !defined(RADIO_CFG_KEYS_H)
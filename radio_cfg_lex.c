@@ -0,0 +1,169 @@
+/*
+ * hamradio.conf tokenizer (see radio_cfg_lex.h)
+ */
+#include <ctype.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <switch.h>
+#include "mod_hamradio.h"
+
+switch_status_t cfg_lex_open(CfgLexer_t *lx, const char *file) {
+   struct stat st;
+   void *map;
+   int fd;
+
+   memset(lx, 0, sizeof(*lx));
+   lx->file = file;
+
+   if ((fd = open(file, O_RDONLY | O_CLOEXEC)) < 0) {
+      return SWITCH_STATUS_FALSE;
+   }
+
+   if (fstat(fd, &st) < 0) {
+      close(fd);
+      return SWITCH_STATUS_FALSE;
+   }
+
+   if ((lx->len = st.st_size) == 0) {
+      close(fd);
+      return SWITCH_STATUS_SUCCESS;
+   }
+
+   // Every line has to end in a byte we can overwrite with a NUL. A file
+   // that ends in \n always does; one that doesn't is read into a buffer
+   // with room for it instead (one allocation)
+   if ((map = mmap(NULL, lx->len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0)) != MAP_FAILED) {
+      if (((char *)map)[lx->len - 1] == '\n') {
+         close(fd);
+         lx->buf = map;
+         lx->mapped = true;
+         return SWITCH_STATUS_SUCCESS;
+      }
+      munmap(map, lx->len);
+   }
+
+   if ((lx->buf = malloc(lx->len + 1)) == NULL || pread(fd, lx->buf, lx->len, 0) != (ssize_t)lx->len) {
+      switch_safe_free(lx->buf);
+      close(fd);
+      return SWITCH_STATUS_FALSE;
+   }
+
+   lx->buf[lx->len] = '\n';
+   close(fd);
+   return SWITCH_STATUS_SUCCESS;
+}
+
+void cfg_lex_close(CfgLexer_t *lx) {
+   if (lx->mapped) {
+      munmap(lx->buf, lx->len);
+   } else {
+      switch_safe_free(lx->buf);
+   }
+
+   lx->buf = NULL;
+   lx->len = lx->pos = 0;
+}
+
+static CfgTokType_t lex_error(CfgTok_t *tok, const char *error) {
+   tok->type = CFG_TOK_ERROR;
+   tok->error = error;
+   return tok->type;
+}
+
+CfgTokType_t cfg_lex_next(CfgLexer_t *lx, CfgTok_t *tok) {
+   memset(tok, 0, sizeof(*tok));
+
+   while (lx->pos < lx->len) {
+      char *start = lx->buf + lx->pos,
+           *eol = memchr(start, '\n', lx->len - lx->pos),
+           *p, *end, *sep, *kend;
+
+      // No \n means the last line of a copied buffer, which has one past the end
+      if (eol == NULL) {
+         eol = lx->buf + lx->len;
+      }
+
+      lx->pos = (eol - lx->buf) + 1;
+      lx->line++;
+
+      // Trim both ends (this also eats the \r of DOS line endings)
+      for (p = start; p < eol && (*p == ' ' || *p == '\t'); p++);
+      for (end = eol; end > p && isspace((unsigned char)end[-1]); end--);
+
+      if (p == end) {
+         continue;
+      }
+
+      // Comments: ; # and // to the end of the line, /* */ around whole lines
+      if (lx->in_comment) {
+         if (end - p >= 2 && end[-2] == '*' && end[-1] == '/') {
+            lx->in_comment = false;
+         }
+         continue;
+      }
+
+      if (*p == ';' || *p == '#' || (p[0] == '/' && end - p > 1 && p[1] == '/')) {
+         continue;
+      }
+
+      if (p[0] == '/' && end - p > 1 && p[1] == '*') {
+         if (end - p < 4 || end[-2] != '*' || end[-1] != '/') {
+            lx->in_comment = true;
+         }
+         continue;
+      }
+
+      // end is at most eol, which is ours to overwrite
+      *end = '\0';
+      tok->line = lx->line;
+      tok->col = (p - start) + 1;
+      tok->key = p;
+      tok->key_len = end - p;
+
+      if (*p == '[') {
+         if (end[-1] != ']') {
+            return lex_error(tok, "section header is missing ]");
+         }
+
+         if (end - p < 3) {
+            return lex_error(tok, "empty section name");
+         }
+
+         end[-1] = '\0';
+         tok->key = p + 1;
+         tok->key_len = end - p - 2;
+         tok->col++;
+         tok->type = CFG_TOK_SECTION;
+         return tok->type;
+      }
+
+      if (strcasecmp(p, "@END") == 0) {
+         tok->type = CFG_TOK_SECTION_END;
+         return tok->type;
+      }
+
+      if ((sep = memchr(p, '=', end - p)) == NULL) {
+         return lex_error(tok, "missing separator (=)");
+      }
+
+      for (kend = sep; kend > p && (kend[-1] == ' ' || kend[-1] == '\t'); kend--);
+
+      if (kend == p) {
+         return lex_error(tok, "missing key before =");
+      }
+
+      *kend = '\0';
+      tok->key_len = kend - p;
+
+      for (p = sep + 1; p < end && (*p == ' ' || *p == '\t'); p++);
+
+      tok->val = p;
+      tok->val_len = end - p;
+      tok->val_col = (p - start) + 1;
+      tok->type = CFG_TOK_KEYVAL;
+      return tok->type;
+   }
+
+   tok->line = lx->line;
+   return CFG_TOK_EOF;
+}
@@ -0,0 +1,50 @@
+#if	!defined(RADIO_CFG_LEX_H)
+#define	RADIO_CFG_LEX_H
+
+//
+// hamradio.conf tokenizer
+//
+// The file is mapped private (our writes never reach the disk) and scanned
+// once, a line at a time, with no length limit. Each line comes back as a
+// token pointing into the mapping: a [section], a key=value pair, @END, or
+// an error saying what's wrong with it. Keys and values are trimmed and NUL
+// terminated in place, so they're plain C strings that cost nothing until
+// someone copies one to keep it. They're only valid until cfg_lex_close().
+//
+typedef enum CfgTokType {
+   CFG_TOK_EOF = 0,
+   CFG_TOK_SECTION,			// [name], name in key
+   CFG_TOK_KEYVAL,			// key=value
+   CFG_TOK_SECTION_END,			// @END
+   CFG_TOK_ERROR			// error says why, key is the whole line
+} CfgTokType_t;
+
+struct CfgTok {
+   CfgTokType_t	type;
+   char		*key;
+   size_t	key_len;
+   char		*val;			// "" if the value is empty, NULL unless CFG_TOK_KEYVAL
+   size_t	val_len;
+   int		line;			// 1-based
+   int		col;			// where key starts (1-based)
+   int		val_col;		// where val starts
+   const char	*error;
+};
+typedef struct CfgTok CfgTok_t;
+
+struct CfgLexer {
+   const char	*file;
+   char		*buf;			// the mapping (or a copy, see cfg_lex_open)
+   size_t	len;
+   size_t	pos;			// start of the next line
+   int		line;
+   switch_bool_t mapped;		// buf is mmap'd, otherwise malloc'd
+   switch_bool_t in_comment;		// inside a /* */ block
+};
+typedef struct CfgLexer CfgLexer_t;
+
+extern switch_status_t cfg_lex_open(CfgLexer_t *lx, const char *file);
+extern CfgTokType_t cfg_lex_next(CfgLexer_t *lx, CfgTok_t *tok);
+extern void cfg_lex_close(CfgLexer_t *lx);
+
+#endif	// !defined(RADIO_CFG_LEX_H)
@@ -0,0 +1,315 @@
+/*
+ * Command queue between session threads and the runtime thread
+ *
+ * Bounded multi-producer, single-consumer ring (Vyukov style): producers
+ * claim a slot by bumping enqueue_pos with a CAS, fill it in and publish it
+ * through the slot's sequence number. The runtime thread is the only
+ * consumer, so dequeuing needs no atomics beyond the sequence handshake.
+ */
+#include <semaphore.h>
+#include "mod_hamradio.h"
+
+#define	RADIO_CMD_QUEUE_MASK	(RADIO_CMD_QUEUE_SIZE - 1)
+#define	RADIO_CMD_WAIT_MS	1000		// longest radio_cmd_submit() waits
+
+// Waiter's side of radio_cmd_submit(), one per thread and reused. The state
+// carries the sequence number of the command it's for, so a command its
+// waiter gave up on can't be mistaken for the next one waited on.
+enum { FUTURE_PENDING = 0, FUTURE_RUNNING, FUTURE_DONE, FUTURE_ABANDONED };
+#define	FUTURE_STATE(seq, st)	(((seq) << 2) | (st))
+
+struct RadioCmdFuture {
+   uint64_t	state;			// FUTURE_STATE(seq, FUTURE_*)
+   uint64_t	seq;			// bumped for every command waited on
+   RadioStatus_t result;
+   sem_t	done;
+   int		ready;			// done has been initialized
+};
+
+static __thread struct RadioCmdFuture my_future;
+
+struct RadioCmd {
+   uint64_t	ticket;			// position in the queue, for ordering
+   int		radio;
+   RadioCmdType_t type;
+   RadioStatus_t state;
+   uint64_t	requested;		// when it was posted (ns, monotonic)
+   struct RadioCmdFuture *future;
+   uint64_t	future_seq;		// which of the future's commands this is
+   radio_cmd_cb_t cb;
+   radio_cmd_fn_t fn;			// RADIO_CMD_CALL
+   void		*data;
+};
+
+struct RadioCmdCell {
+   uint64_t	seq;
+   struct RadioCmd cmd;
+};
+
+static struct {
+   struct RadioCmdCell cells[RADIO_CMD_QUEUE_SIZE];
+   uint64_t	enqueue_pos __attribute__((aligned(64)));	// producers fight over this
+   uint64_t	dequeue_pos __attribute__((aligned(64)));	// runtime thread only
+   int		running;
+   int		initialized;
+} cmdq;
+
+static __thread int on_runtime_thread = 0;
+
+//////////////////////
+// Queue primitives //
+//////////////////////
+static void cmdq_init(void) {
+   for (uint64_t i = 0; i < RADIO_CMD_QUEUE_SIZE; i++) {
+      __atomic_store_n(&cmdq.cells[i].seq, i, __ATOMIC_RELAXED);
+   }
+
+   __atomic_store_n(&cmdq.enqueue_pos, 0, __ATOMIC_RELAXED);
+   cmdq.dequeue_pos = 0;
+   __atomic_store_n(&cmdq.initialized, 1, __ATOMIC_RELEASE);
+}
+
+static switch_bool_t cmdq_push(struct RadioCmd *cmd) {
+   struct RadioCmdCell *cell;
+   uint64_t pos = __atomic_load_n(&cmdq.enqueue_pos, __ATOMIC_RELAXED);
+
+   for (;;) {
+      int64_t diff;
+
+      cell = &cmdq.cells[pos & RADIO_CMD_QUEUE_MASK];
+      diff = (int64_t)__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - (int64_t)pos;
+
+      if (diff == 0) {
+         if (__atomic_compare_exchange_n(&cmdq.enqueue_pos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            break;
+         }
+      } else if (diff < 0) {
+         // Full, the runtime thread hasn't caught up
+         return false;
+      } else {
+         pos = __atomic_load_n(&cmdq.enqueue_pos, __ATOMIC_RELAXED);
+      }
+   }
+
+   cmd->ticket = pos;
+   cell->cmd = *cmd;
+   __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+   return true;
+}
+
+static switch_bool_t cmdq_pop(struct RadioCmd *cmd) {
+   struct RadioCmdCell *cell = &cmdq.cells[cmdq.dequeue_pos & RADIO_CMD_QUEUE_MASK];
+
+   if (__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) != cmdq.dequeue_pos + 1) {
+      return false;
+   }
+
+   *cmd = cell->cmd;
+   __atomic_store_n(&cell->seq, cmdq.dequeue_pos + RADIO_CMD_QUEUE_SIZE, __ATOMIC_RELEASE);
+   cmdq.dequeue_pos++;
+   return true;
+}
+
+//////////////
+// Applying //
+//////////////
+static RadioStatus_t cmd_apply(const struct RadioCmd *cmd) {
+   const int radio = cmd->radio;
+   const RadioStatus_t state = cmd->state;
+   const uint64_t requested = cmd->requested;
+
+   switch (cmd->type) {
+      case RADIO_CMD_ENABLE:
+         return radio_enable(radio);
+      case RADIO_CMD_DISABLE:
+         return radio_disable(radio);
+      case RADIO_CMD_SET_STATE:
+         // PTT latency counts from when the request was posted, not when we got to it
+         if ((state == RADIO_TX || state == RADIO_TX_DATA) && radio_exists(radio) && Radios(radio).ptt_requested == 0) {
+            Radios(radio).ptt_requested = requested;
+         }
+         return radio_set_state(radio, state);
+      case RADIO_CMD_CONF_PTT_ON:
+      case RADIO_CMD_CONF_PTT_OFF:
+         if (radio_conf_ptt(radio, (cmd->type == RADIO_CMD_CONF_PTT_ON), requested) < 0) {
+            return RADIO_ERROR;
+         }
+         return state;
+      case RADIO_CMD_CALL:
+         cmd->fn(cmd->data);
+         return state;
+   }
+
+   return RADIO_ERROR;
+}
+
+// Is anybody still waiting for it? A command whose waiter timed out is dropped, not applied late
+static switch_bool_t cmd_claim(struct RadioCmd *cmd) {
+   uint64_t expected;
+
+   if (cmd->future == NULL) {
+      return true;
+   }
+
+   expected = FUTURE_STATE(cmd->future_seq, FUTURE_PENDING);
+   return __atomic_compare_exchange_n(&cmd->future->state, &expected, FUTURE_STATE(cmd->future_seq, FUTURE_RUNNING), false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+static void cmd_complete(struct RadioCmd *cmd, const RadioStatus_t result) {
+   struct RadioCmdFuture *f = cmd->future;
+
+   radio_trace(TRACE_COMMAND, cmd->radio, cmd->ticket, result);
+
+   if (cmd->cb) {
+      cmd->cb(cmd->radio, cmd->ticket, result, cmd->data);
+   }
+
+   if (f) {
+      f->result = result;
+      __atomic_store_n(&f->state, FUTURE_STATE(cmd->future_seq, FUTURE_DONE), __ATOMIC_RELEASE);
+      sem_post(&f->done);
+   }
+}
+
+// Apply everything that's been posted, in order. Runtime thread only.
+int radio_cmd_run(void) {
+   struct RadioCmd cmd;
+   int n = 0;
+
+   if (!__atomic_load_n(&cmdq.initialized, __ATOMIC_ACQUIRE)) {
+      return 0;
+   }
+
+   while (cmdq_pop(&cmd)) {
+      // Its waiter already logged it as dropped
+      if (!cmd_claim(&cmd)) {
+         continue;
+      }
+
+      cmd_complete(&cmd, cmd_apply(&cmd));
+      n++;
+   }
+
+   return n;
+}
+
+void radio_cmd_runtime_start(void) {
+   if (!cmdq.initialized) {
+      cmdq_init();
+   }
+
+   on_runtime_thread = 1;
+   __atomic_store_n(&cmdq.running, 1, __ATOMIC_SEQ_CST);
+}
+
+void radio_cmd_runtime_stop(void) {
+   __atomic_store_n(&cmdq.running, 0, __ATOMIC_SEQ_CST);
+
+   // Anything that snuck in still gets applied, nobody is left waiting
+   radio_cmd_run();
+   on_runtime_thread = 0;
+}
+
+/////////////
+// Posting //
+/////////////
+static switch_bool_t cmd_inline(void) {
+   return (on_runtime_thread || !__atomic_load_n(&cmdq.running, __ATOMIC_SEQ_CST));
+}
+
+switch_status_t radio_cmd_post(const int radio, const RadioCmdType_t type, const RadioStatus_t state, radio_cmd_cb_t cb, void *data) {
+   struct RadioCmd cmd = { 0, radio, type, state, radio_now_ns(), NULL, 0, cb, NULL, data };
+
+   if (cmd_inline()) {
+      cmd_complete(&cmd, cmd_apply(&cmd));
+      return SWITCH_STATUS_SUCCESS;
+   }
+
+   if (!cmdq_push(&cmd)) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[radio] command queue full, dropping command for radio%d\n", radio);
+      return SWITCH_STATUS_FALSE;
+   }
+
+   radio_core_wakeup();
+   return SWITCH_STATUS_SUCCESS;
+}
+
+// Queue cmd and wait for it. SWITCH_STATUS_TIMEOUT if the runtime thread didn't
+// get to it in time: it's dropped then, never applied after we've given up.
+static switch_status_t cmd_wait(struct RadioCmd *cmd, RadioStatus_t *result) {
+   struct RadioCmdFuture *f = &my_future;
+   struct timespec deadline;
+   uint64_t expected;
+
+   if (!f->ready) {
+      sem_init(&f->done, 0, 0);
+      f->ready = 1;
+   }
+
+   cmd->future = f;
+   cmd->future_seq = ++f->seq;
+   __atomic_store_n(&f->state, FUTURE_STATE(cmd->future_seq, FUTURE_PENDING), __ATOMIC_RELEASE);
+
+   if (!cmdq_push(cmd)) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[radio] command queue full, refusing command for radio%d\n", cmd->radio);
+      return SWITCH_STATUS_FALSE;
+   }
+
+   radio_core_wakeup();
+
+   clock_gettime(CLOCK_REALTIME, &deadline);
+   deadline.tv_sec += RADIO_CMD_WAIT_MS / 1000;
+   deadline.tv_nsec += (RADIO_CMD_WAIT_MS % 1000) * 1000000;
+
+   if (deadline.tv_nsec >= 1000000000) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000;
+   }
+
+   while (sem_timedwait(&f->done, &deadline) < 0) {
+      if (errno == EINTR) {
+         continue;
+      }
+
+      // Timed out: take it back, unless the runtime thread already started on it
+      expected = FUTURE_STATE(cmd->future_seq, FUTURE_PENDING);
+
+      if (__atomic_compare_exchange_n(&f->state, &expected, FUTURE_STATE(cmd->future_seq, FUTURE_ABANDONED), false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "[radio] radio%d command #%" PRIu64 " not started within %d ms, dropped\n", cmd->radio, cmd->ticket, RADIO_CMD_WAIT_MS);
+         return SWITCH_STATUS_TIMEOUT;
+      }
+
+      // Being applied (or just done), the post is on its way
+      while (sem_wait(&f->done) < 0 && errno == EINTR) {
+         ;
+      }
+      break;
+   }
+
+   *result = f->result;
+   return SWITCH_STATUS_SUCCESS;
+}
+
+RadioStatus_t radio_cmd_submit(const int radio, const RadioCmdType_t type, const RadioStatus_t state) {
+   struct RadioCmd cmd = { 0, radio, type, state, radio_now_ns(), NULL, 0, NULL, NULL, NULL };
+   RadioStatus_t result = RADIO_ERROR;
+
+   if (cmd_inline()) {
+      return cmd_apply(&cmd);
+   }
+
+   cmd_wait(&cmd, &result);
+   return result;
+}
+
+switch_status_t radio_cmd_call(radio_cmd_fn_t fn, void *data) {
+   struct RadioCmd cmd = { 0, -1, RADIO_CMD_CALL, RADIO_IDLE, radio_now_ns(), NULL, 0, NULL, fn, data };
+   RadioStatus_t result;
+
+   if (cmd_inline()) {
+      fn(data);
+      return SWITCH_STATUS_SUCCESS;
+   }
+
+   return cmd_wait(&cmd, &result);
+}
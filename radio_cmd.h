@@ -0,0 +1,54 @@
+#if	!defined(RADIO_CMD_H)
+#define	RADIO_CMD_H
+
+//
+// Commands for the runtime thread
+//
+// State changes requested from session threads (dialplan apps, the API) are
+// posted to a bounded lock-free MPSC ring and applied, in the order they were
+// posted, by the runtime thread. That makes it the only thread changing a
+// radio during normal operation. Each command gets a ticket (its position in
+// the ring) so competing PTT requests can be matched up in the trace output.
+//
+// Called from the runtime thread itself, or while it isn't running (loading,
+// unloading), commands are simply applied on the spot.
+//
+// A waiter that gives up (RADIO_CMD_WAIT_MS) takes its command back, so it is
+// dropped rather than applied after the caller has been told it failed. Once
+// the runtime thread has started on a command, the waiter stays for the result.
+//
+#define	RADIO_CMD_QUEUE_SIZE	256		// power of 2
+
+typedef enum RadioCmdType {
+   RADIO_CMD_SET_STATE = 0,
+   RADIO_CMD_ENABLE,
+   RADIO_CMD_DISABLE,
+   RADIO_CMD_CONF_PTT_ON,			// radio is the conference #
+   RADIO_CMD_CONF_PTT_OFF,
+   RADIO_CMD_CALL				// run a function (see radio_cmd_call)
+} RadioCmdType_t;
+
+// Completion callback for radio_cmd_post(), runs on the runtime thread
+typedef void (*radio_cmd_cb_t)(const int radio, const uint64_t ticket, const RadioStatus_t result, void *data);
+
+// Work for radio_cmd_call(), runs on the runtime thread
+typedef void (*radio_cmd_fn_t)(void *data);
+
+// Apply a command and wait (up to a second) for the result
+extern RadioStatus_t radio_cmd_submit(const int radio, const RadioCmdType_t type, const RadioStatus_t state);
+
+// Run fn(data) on the runtime thread, between its other work, and wait for it.
+// This is how the radio table, GPIO requests and conferences are changed, so
+// the runtime thread never has to lock anything to use them. SWITCH_STATUS_TIMEOUT
+// (or FALSE, queue full) means fn never ran.
+extern switch_status_t radio_cmd_call(radio_cmd_fn_t fn, void *data);
+
+// Queue a command and return immediately, cb (if any) gets the result
+extern switch_status_t radio_cmd_post(const int radio, const RadioCmdType_t type, const RadioStatus_t state, radio_cmd_cb_t cb, void *data);
+
+// For the runtime thread
+extern void radio_cmd_runtime_start(void);
+extern void radio_cmd_runtime_stop(void);
+extern int radio_cmd_run(void);
+
+#endif	// !defined(RADIO_CMD_H)
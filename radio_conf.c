@@ -6,6 +6,87 @@
 #include <switch.h>
 #include "mod_hamradio.h"
 
+static Conference_t conferences[CONFERENCE_MAX];
+
 int radio_conference_init(void) {
     return SWITCH_STATUS_SUCCESS;
 }
+
+void radio_conference_reset(Conference_t *set) {
+    memset(set, 0, CONFERENCE_MAX * sizeof(*set));
+
+    for (int i = 0; i < CONFERENCE_MAX; i++) {
+       set[i].master_radio = -1;
+    }
+}
+
+void radio_conference_apply(const Conference_t *set) {
+    memcpy(conferences, set, sizeof(conferences));
+}
+
+Conference_t *radio_conference(const int conf) {
+    if (conf < 0 || conf >= CONFERENCE_MAX || conf >= globals.max_conferences || !conferences[conf].configured) {
+       return NULL;
+    }
+
+    return &conferences[conf];
+}
+
+// radios=0,1,3
+static switch_status_t conference_parse_radios(Conference_t *c, const char *val) {
+    char *list = strdup(val), *save = NULL, *tok;
+    switch_status_t rv = SWITCH_STATUS_SUCCESS;
+
+    if (list == NULL) {
+       return SWITCH_STATUS_MEMERR;
+    }
+
+    memset(c->radios, 0, sizeof(c->radios));
+
+    for (tok = strtok_r(list, ", ", &save); tok; tok = strtok_r(NULL, ", ", &save)) {
+       int radio = atoi(tok);
+
+       if (radio < 0 || radio >= CONFERENCE_RADIO_WORDS * 64) {
+          switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "conference%s: radio '%s' is out of range\n", c->id, tok);
+          rv = SWITCH_STATUS_FALSE;
+          continue;
+       }
+
+       c->radios[radio / 64] |= (1ULL << (radio % 64));
+    }
+
+    free(list);
+    return rv;
+}
+
+switch_status_t radio_conference_config(Conference_t *set, const int conf, const char *key, const char *val) {
+    Conference_t *c;
+
+    if (conf < 0 || conf >= CONFERENCE_MAX) {
+       switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "conference%d is out of range (max %d)\n", conf, CONFERENCE_MAX);
+       return SWITCH_STATUS_FALSE;
+    }
+
+    c = &set[conf];
+
+    if (!c->configured) {
+       snprintf(c->id, sizeof(c->id), "%d", conf);
+       c->configured = true;
+    }
+
+    if (strcasecmp(key, "radios") == 0) {
+       return conference_parse_radios(c, val);
+    } else if (strcasecmp(key, "master_radio") == 0) {
+       c->master_radio = atoi(val);
+    } else if (strcasecmp(key, "admin_pin") == 0) {
+       snprintf(c->admin_pin, sizeof(c->admin_pin), "%s", val);
+    } else if (strcasecmp(key, "listen_pin") == 0) {
+       snprintf(c->listen_pin, sizeof(c->listen_pin), "%s", val);
+    } else if (strcasecmp(key, "description") == 0) {
+       snprintf(c->description, sizeof(c->description), "%s", val);
+    } else {
+       switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "conference%d: unknown key '%s'\n", conf, key);
+    }
+
+    return SWITCH_STATUS_SUCCESS;
+}
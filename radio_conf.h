@@ -1,14 +1,38 @@
 #if	!defined(CONFERENCE_H)
 #define	CONFERENCE_H
 
+#define	CONFERENCE_MAX		32		// [conferenceN] sections we'll accept
+#define	CONFERENCE_RADIO_WORDS	(256 / 64)	// bitmask words, enough for RADIO_TABLE_MAX
+
 struct	Conference {
     char id[32];
     char description[128];
+    switch_bool_t configured;	// seen in hamradio.conf
 
     // Participants
-    u_int8_t	radios;		// bitmask of radios in the conference
+    uint64_t	radios[CONFERENCE_RADIO_WORDS];	// bitmask of radios in the conference
+    int		master_radio;
+    char	admin_pin[16];
+    char	listen_pin[16];
 };
+typedef struct Conference Conference_t;
 
 extern int radio_conference_init(void);
 
+// Forget every conference in set (CONFERENCE_MAX of them), before a full configuration load stages new ones
+extern void radio_conference_reset(Conference_t *set);
+
+// Replace the running conferences with a staged set. Table writers only (see radio_table.h)
+extern void radio_conference_apply(const Conference_t *set);
+
+// Look up a configured conference, NULL if there isn't one. Runtime thread only (that's where they're replaced)
+extern Conference_t *radio_conference(const int conf);
+
+// Parse one key from a [conferenceN] section into set
+extern switch_status_t radio_conference_config(Conference_t *set, const int conf, const char *key, const char *val);
+
+static inline switch_bool_t radio_conference_has(const Conference_t *c, const int radio) {
+    return (radio >= 0 && radio < CONFERENCE_RADIO_WORDS * 64 && (c->radios[radio / 64] & (1ULL << (radio % 64))));
+}
+
 #endif	// !defined(CONFERENCE_H)
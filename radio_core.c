@@ -2,136 +2,306 @@
  * FreeSWITCH core processing (main thread)
  *
  * Here we handle tasks that must be completed on a periodic basis
- * such as polling PTTs and squelches. Try to keep code here lean.
+ * such as watching squelches and enforcing TOT. Try to keep code here lean.
  */
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include "mod_hamradio.h"
 
+#define	RUNTIME_MAX_EVENTS	16
+// epoll data tag for the wakeup eventfd
+#define	RUNTIME_WAKEUP		0xffffffff
+// ... and for the timer wheel's timerfd
+#define	RUNTIME_TIMER		0xfffffffe
+// ... and the GPIO line request(s)
+#define	RUNTIME_GPIO		0xfffffffd
+
+static int runtime_epfd = -1;		// epoll set: wakeup eventfd + squelch lines
+static int runtime_wakefd = -1;		// eventfd used to interrupt epoll_wait
+static RadioTimer_t housekeeping_timer;	// periodic work that isn't tied to a deadline (VOX, etc)
+
+// Where the runtime thread is, so shutdown knows whether (and how long) to wait for it
+enum { RUNTIME_NOT_STARTED = 0, RUNTIME_RUNNING, RUNTIME_EXITED };
+static int runtime_state = RUNTIME_NOT_STARTED;
+
+// Tell the runtime thread to stop, and wait until it has let go of everything
+void radio_core_stop(void) {
+   int expected = RUNTIME_NOT_STARTED;
+
+   globals.alive = 0;
+
+   // Never got going? Then it never will
+   if (__atomic_compare_exchange_n(&runtime_state, &expected, RUNTIME_EXITED, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      return;
+   }
+
+   radio_core_wakeup();
+
+   for (int waited = 0; __atomic_load_n(&runtime_state, __ATOMIC_ACQUIRE) != RUNTIME_EXITED; waited++) {
+      if (waited == 5000) {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "hamradio: still waiting for the runtime thread to exit...\n");
+      }
+      switch_yield(1000);
+   }
+
+   __atomic_store_n(&runtime_state, RUNTIME_NOT_STARTED, __ATOMIC_RELEASE);
+}
+
+void radio_core_wakeup(void) {
+   uint64_t one = 1;
+
+   if (runtime_wakefd >= 0) {
+      if (write(runtime_wakefd, &one, sizeof(one)) != sizeof(one)) {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "hamradio: failed to wake runtime thread: %s\n", strerror(errno));
+      }
+   }
+}
+
+// (Re)build the epoll set from the currently requested squelch lines
+static void radio_core_arm_squelch(void) {
+   struct epoll_event ev;
+   int fd;
+
+   // housekeeping_timer lives on the timer wheel, not in this set, so it keeps running
+
+   if (runtime_epfd >= 0) {
+      close(runtime_epfd);
+   }
+
+   if ((runtime_epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "hamradio: epoll_create1 failed: %s\n", strerror(errno));
+      return;
+   }
+
+   memset(&ev, 0, sizeof(ev));
+   ev.events = EPOLLIN;
+   ev.data.u32 = RUNTIME_WAKEUP;
+   epoll_ctl(runtime_epfd, EPOLL_CTL_ADD, runtime_wakefd, &ev);
+
+   ev.data.u32 = RUNTIME_TIMER;
+   epoll_ctl(runtime_epfd, EPOLL_CTL_ADD, radio_timer_fd(), &ev);
+
+   // One fd per GPIO chip carries the edges for every squelch line on it
+   if ((fd = radio_gpio_event_fd()) >= 0) {
+      ev.events = EPOLLIN;
+      ev.data.u32 = RUNTIME_GPIO;
+
+      if (epoll_ctl(runtime_epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "hamradio: can't watch squelch lines: %s\n", strerror(errno));
+      }
+   }
+
+   for (int radio = 0; radio < globals.max_radios; radio++) {
+      if (!radio_exists(radio)) {
+         continue;
+      }
+
+      Radio_t *r = &Radios(radio);
+
+      if (r->RX_mode != SQUELCH_GPIO || r->gpio_squelch == NULL) {
+         continue;
+      }
+
+      // Pick up the current level, edges only tell us about changes from here on
+      int sqval = radio_gpio_read_squelch(radio);
+
+      radio_squelch_setup(radio);
+      radio_squelch_reset(radio, sqval);
+      radio_core_squelch(radio, sqval, time(NULL));
+   }
+}
+
+// A radio's (debounced) squelch changed state
+void radio_core_squelch(const int radio, const int sqval, const time_t now) {
+   Radio_t *r = &Radios(radio);
+
+   if (sqval < 0) {
+      return;
+   }
+
+   radio_trace(TRACE_SQUELCH, radio, sqval, r->squelch.glitches);
+
+   // Are we in automatic control mode? If not, ignore the input
+   if (r->RX_mode != SQUELCH_GPIO) {
+      return;
+   }
+
+   if (sqval == 1) {
+      // XXX: Find all conferences this radio is in and raise it's RXing flag
+      // radio_confs_find_byradio(radio)
+
+      // Don't let a squelch opening power up a radio or cut off a transmission
+      if (r->status == RADIO_IDLE) {
+         if (radio_set_state(radio, RADIO_RX) == RADIO_RX && r->squelch.raw_since) {
+            // From the kernel's timestamp on the edge to RX state (includes the debounce delay)
+            radio_hist_add(&r->cold->lat_squelch, (radio_now_ns() - r->squelch.raw_since) / 1000);
+         }
+         radio_state_write_begin(r);
+         r->last_rx = now;
+         radio_state_write_end(r);
+      }
+   } else if (r->status == RADIO_RX) {
+      radio_set_state(radio, RADIO_IDLE);
+      radio_state_write_begin(r);
+      r->last_rx = now;
+      radio_state_write_end(r);
+   }
+}
+
+static void radio_core_housekeeping(const int unused, void *data) {
+   time_t now = time(NULL);
+
+   for (int radio = 0; radio < globals.max_radios; radio++) {
+      if (!radio_exists(radio)) {
+         continue;
+      }
+
+      Radio_t *r = &Radios(radio);
+
+      // If we are in VAD mod, try to determine if this radio has activity
+      if (r->RX_mode == SQUELCH_VOX) {
+         // XXX: Check squelch PTT status
+         // if (vad_is_voice(radio)) {
+         //    radio_set_state(radio, RADIO_RX);
+      }
+
+      // Handle tasks specific to the state of the selected radio (RX, TX, TXDATA)
+      // TOT, penalties and IDs are deadlines on the timer wheel (see radio_timers_setup)
+      if (r->status == RADIO_RX) {
+         // Here we should do receive radio stuff, like establish audio if not already done
+      } else if (r->status == RADIO_TX) {
+         // store last TX as now
+         radio_state_write_begin(r);
+         r->last_tx = now;
+         radio_state_write_end(r);
+      } else if (r->status == RADIO_TX_DATA) {
+            // XXX: Handle modem tasks here
+            // store last TX time
+            radio_state_write_begin(r);
+            r->last_tx = now;
+            radio_state_write_end(r);
+      }
+   }
+
+   radio_timer_arm(&housekeeping_timer, (globals.poll_interval > 0 ? globals.poll_interval : 1000));
+}
+
 ///////////////////////////////////////
 // Here is where out main logic runs //
 ///////////////////////////////////////
-// We poll the radio stack periodically (poll_interval setting)
-// and do things based on what we find.
-// We need to be reasonably fast here and try to keep CPU usage
-// responsible...
+// We sleep in epoll until a squelch line changes (libgpiod edge events),
+// someone wakes us up, or the timer wheel has a deadline due (TOT, penalty,
+// ID, housekeeping every poll_interval ms). Nothing here spins or rescans
+// the radios looking for expired timers.
+//
+// Nothing here takes a lock either: reloads, adds and removes change the
+// radio table and GPIO requests by handing us the work (radio_cmd_call), so
+// nobody else changes them while we're using them.
 SWITCH_MODULE_RUNTIME_FUNCTION(mod_hamradio_runtime) {
-   time_t last_tick;
+   struct epoll_event events[RUNTIME_MAX_EVENTS];
+   int armed_generation = -1, rcu, expected = RUNTIME_NOT_STARTED;
 
    // Wait for the main process to be ready
    while (!globals.alive) {
+      if (__atomic_load_n(&runtime_state, __ATOMIC_ACQUIRE) == RUNTIME_EXITED) {
+         return SWITCH_STATUS_TERM;
+      }
       sleep(1);
    }
 
+   // Shutdown got here first
+   if (!__atomic_compare_exchange_n(&runtime_state, &expected, RUNTIME_RUNNING, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      return SWITCH_STATUS_TERM;
+   }
+
+   if ((runtime_wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "hamradio: eventfd failed: %s\n", strerror(errno));
+      __atomic_store_n(&runtime_state, RUNTIME_EXITED, __ATOMIC_RELEASE);
+      return SWITCH_STATUS_TERM;
+   }
+
    switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "hamradio interface control thread waking up!\n");
 
-   // As long as we aren't shutting down, scan the radios
-   while (globals.alive) {
-//      switch_time_t now = switch_micro_time_now();
-      switch_time_t now = time(NULL);
-
-      for (int radio = 0; radio < globals.max_radios; radio++) {
-         Radio_t *r = &Radios(radio);
-         int sqval = 0;
-         switch_bool_t squelch_state = false;
-
-         // Another second has passed, reduce penalty time on this radio
-         if (r->penalty > 0) {
-            // This should only happen once per second, make sure that's the case...
-            if (last_tick && (now - last_tick >= 1)) {
-               r->penalty -= (now - last_tick);
-            }
+   // Priority, CPU pinning and memory locking, then see how well that worked
+   radio_rt_apply("runtime thread");
+   radio_rt_selftest();
 
-            last_tick = now;
+   // From here on other threads queue their state changes for us
+   radio_cmd_runtime_start();
 
-            // penalty expired?
-            if (r->penalty == 0) {
-               switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "radio%d penalty cleared\n", radio);
+   radio_timer_setup(&housekeeping_timer, "housekeeping", -1, radio_core_housekeeping, NULL);
+   radio_timer_arm(&housekeeping_timer, 0);
 
-               // Optionally Play a status tone to indicate penalty time over
-               radio_send_tones(radio, "penalty_clear");
-            }
+   // As long as we aren't shutting down, wait for work
+   while (globals.alive) {
+      int n;
+
+      // GPIO was (re)initialized, watch the new squelch lines
+      if (armed_generation != globals.gpio_generation) {
+         rcu = radio_rcu_read_lock();
+         armed_generation = globals.gpio_generation;
+         radio_core_arm_squelch();
+         radio_rcu_read_unlock(rcu);
+      }
+
+      if ((n = epoll_wait(runtime_epfd, events, RUNTIME_MAX_EVENTS, -1)) < 0) {
+         if (errno != EINTR) {
+            switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "hamradio: epoll_wait failed: %s\n", strerror(errno));
+            switch_yield(100000);
          }
+         continue;
+      }
 
-         // Check the GPIO squelch input line here
-         if (r->gpio_squelch != NULL) {
-            switch_bool_t gpio_squelch_state = false;
-            sqval = radio_gpio_read_squelch(radio);
-            switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "radio%d read squelch val = %d\n", radio, sqval);
-
-            // Handle inverting the signal, if needed for this radio
-            if (r->squelch_invert) {
-               if (sqval < r->squelch_min) {
-                  squelch_state = false;
-               }
-            } else {
-               if (sqval > r->squelch_min) {
-                  squelch_state = true;
-               }
-            }
+      if (!globals.alive) {
+         break;
+      }
 
-            // There is received activity
-            if (gpio_squelch_state == true) {
-               // Are we in automatic control mode? If not, ignore the input
-               if ((r->RX_mode == SQUELCH_GPIO)) {
-                  // XXX: Find all conferences this radio is in and raise it's RXing flag
-                  // radio_confs_find_byradio(radio)
-                  squelch_state = true;
-               }
+      // Keep any radio removed meanwhile around until we're done with it
+      rcu = radio_rcu_read_lock();
+      for (int i = 0; i < n; i++) {
+         if (events[i].data.u32 == RUNTIME_TIMER) {
+            radio_timer_run();
+            continue;
+         } else if (events[i].data.u32 == RUNTIME_WAKEUP) {
+            uint64_t junk;
+
+            if (read(runtime_wakefd, &junk, sizeof(junk)) < 0 && errno != EAGAIN) {
+               switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "hamradio: reading wakeup fd failed: %s\n", strerror(errno));
             }
-         }
 
-         // If we are in VAD mod, try to determine if this radio has activity
-         if (r->RX_mode == SQUELCH_VOX) {
-            // XXX: Check squelch PTT status
-            // if (vad_is_voice(radio)) {
-            //    squelch_state = true;
-         }
- 
-         // If any of the squelch inputs were configured and came up, set RX flags
-         if (squelch_state == true) {
-            // Set receiving state on
-            radio_set_state(radio, RADIO_RX);
-            // Store last received time
-            r->last_rx = now;
-         } else if ((r->status == RADIO_RX) && (squelch_state == false)) {
-            radio_set_state(radio, RADIO_IDLE);
-            r->last_rx = now;
+            // Apply any state changes (and reloads) that were queued for us, in order
+            radio_cmd_run();
+            continue;
          }
 
-         // Handle tasks specific to the state of the selected radio (RX, TX, TXDATA)
-         if (r->status == RADIO_RX) {
-            // Here we should do receive radio stuff, like establish audio if not already done
-         } else if (r->status == RADIO_TX) {
-            // is a timeout timer set on this channel?
-            if (r->timeout_talk > 0) {
-               // Has the timer expired?
-               if (now >= (r->talk_start + r->timeout_talk)) {
-                  switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "radio%d ending transmission (TOT expired: %lu, adding %lu penalty)\n", radio, r->timeout_talk, r->timeout_holdoff);
-
-                  // Apply a delay before allowing TX again
-                  r->penalty += r->timeout_holdoff;
-
-                  // Turn the PTT off
-                  radio_ptt_off(radio);
-               }
-
-               // store last TX as now
-               r->last_tx = now;
-            }
-         } else if (r->status == RADIO_TX_DATA) {
-               // XXX: Implement duty cycle management!
-               // XXX: Handle modem tasks here
-               // store last TX time
-               r->last_tx = now;
+         // Skip stale events if GPIO was torn down while we slept
+         if (armed_generation != globals.gpio_generation) {
+            break;
          }
 
-         // XXX: Check ident timeouts
+         // Edges go through the debouncer, which calls radio_core_squelch() once they stick
+         if (events[i].data.u32 == RUNTIME_GPIO) {
+            radio_gpio_events();
+         }
       }
+      radio_rcu_read_unlock(rcu);
+   }
 
-      // This allows reducing CPU load in the polling code, if needed
-      if (globals.poll_interval > 0) {
-         usleep(globals.poll_interval);
-      }
-      switch_cond_next();
+   radio_timer_cancel(&housekeeping_timer);
+
+   rcu = radio_rcu_read_lock();
+   radio_cmd_runtime_stop();
+   radio_rcu_read_unlock(rcu);
+
+   if (runtime_epfd >= 0) {
+      close(runtime_epfd);
+      runtime_epfd = -1;
    }
+
+   close(runtime_wakefd);
+   runtime_wakefd = -1;
+
+   // radio_core_stop() can go on tearing things down
+   __atomic_store_n(&runtime_state, RUNTIME_EXITED, __ATOMIC_RELEASE);
    return SWITCH_STATUS_TERM;
 }
@@ -0,0 +1,13 @@
+#if	!defined(RADIO_CORE_H)
+#define	RADIO_CORE_H
+
+// Kick the runtime thread out of its wait (reload, shutdown, etc)
+extern void radio_core_wakeup(void);
+
+// Stop the runtime thread and wait for it to exit (shutdown, before anything it uses is torn down)
+extern void radio_core_stop(void);
+
+// Debounced squelch state for a radio changed (1 = open)
+extern void radio_core_squelch(const int radio, const int sqval, const time_t now);
+
+#endif	// !defined(RADIO_CORE_H)
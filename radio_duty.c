@@ -0,0 +1,130 @@
+/*
+ * Duty cycle limits (token bucket per radio)
+ */
+#include "mod_hamradio.h"
+
+static int64_t duty_capacity(const RadioDuty_t *d) {
+   return (int64_t)(d->window_ms * d->pct);
+}
+
+// Credit the refill (and debit any TX) since the last update
+static void duty_update(RadioDuty_t *d, const uint64_t now) {
+   int64_t elapsed = (int64_t)(now - d->updated);
+
+   d->tokens += elapsed * d->pct;
+
+   if (d->tx) {
+      d->tokens -= elapsed * 100;
+   }
+
+   if (d->tokens > duty_capacity(d)) {
+      d->tokens = duty_capacity(d);
+   }
+
+   d->updated = now;
+}
+
+static void duty_expired(const int radio, void *data) {
+   if (!radio_exists(radio)) {
+      return;
+   }
+
+   radio_trace(TRACE_DUTY_EXHAUSTED, radio, Radios(radio).cold->duty.pct, Radios(radio).cold->duty.window_ms / 1000);
+   radio_ptt_off(radio);
+}
+
+void radio_duty_configure(const int radio, const uint32_t pct, const uint64_t window_ms) {
+   RadioDuty_t *d;
+
+   if (!radio_exists(radio)) {
+      return;
+   }
+
+   d = &Radios(radio).cold->duty;
+
+   if (d->timer.cb == NULL) {
+      radio_timer_setup(&d->timer, "duty", radio, duty_expired, NULL);
+   }
+
+   // Same limit again (reload)? Keep what's left of the budget
+   if (d->pct == (pct >= 100 ? 0 : pct) && d->window_ms == window_ms) {
+      return;
+   }
+
+   d->pct = (pct >= 100 ? 0 : pct);
+   d->window_ms = window_ms;
+   d->updated = radio_now_ms();
+   d->tokens = duty_capacity(d);
+}
+
+switch_bool_t radio_duty_tx_start(const int radio) {
+   RadioDuty_t *d = &Radios(radio).cold->duty;
+   uint64_t now = radio_now_ms();
+
+   if (d->pct == 0 || d->window_ms == 0) {
+      return true;
+   }
+
+   duty_update(d, now);
+
+   if (d->tokens <= 0) {
+      return false;
+   }
+
+   // Net drain while keyed is (100 - pct) per ms, cut TX when we hit empty
+   d->tx = true;
+   radio_timer_arm(&d->timer, d->tokens / (100 - d->pct));
+   return true;
+}
+
+void radio_duty_tx_end(const int radio) {
+   RadioDuty_t *d = &Radios(radio).cold->duty;
+
+   if (!d->tx) {
+      return;
+   }
+
+   duty_update(d, radio_now_ms());
+   d->tx = false;
+   radio_timer_cancel(&d->timer);
+}
+
+time_t radio_duty_remaining(const int radio) {
+   RadioDuty_t *d;
+   int64_t tokens, elapsed;
+
+   if (!radio_exists(radio)) {
+      return -1;
+   }
+
+   d = &Radios(radio).cold->duty;
+
+   if (d->pct == 0 || d->window_ms == 0) {
+      return -1;
+   }
+
+   // Same sums as duty_update, without writing anything back (we may not be the runtime thread)
+   elapsed = (int64_t)(radio_now_ms() - __atomic_load_n(&d->updated, __ATOMIC_RELAXED));
+   tokens = __atomic_load_n(&d->tokens, __ATOMIC_RELAXED) + (elapsed * d->pct);
+
+   if (__atomic_load_n(&d->tx, __ATOMIC_RELAXED)) {
+      tokens -= elapsed * 100;
+   }
+
+   if (tokens > duty_capacity(d)) {
+      tokens = duty_capacity(d);
+   }
+
+   // Seconds of TX at 100% before the bucket is empty
+   return (tokens > 0 ? tokens / (100 - d->pct) / 1000 : 0);
+}
+
+uint64_t radio_duty_parse_window(const char *val) {
+   uint64_t ms;
+
+   if (dconf_parse_duration(val, 1000, &ms) != SWITCH_STATUS_SUCCESS) {
+      return 0;
+   }
+
+   return ms;
+}
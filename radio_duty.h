@@ -0,0 +1,39 @@
+#if	!defined(RADIO_DUTY_H)
+#define	RADIO_DUTY_H
+
+//
+// Duty cycle limits
+//
+// [radioN] duty_cycle=50 and duty_window=10m mean "no more than 50% TX over
+// any 10 minutes". That's kept as a token bucket holding window * pct worth
+// of TX time: it refills at pct and drains at 100% while transmitting, so
+// both checking and charging are O(1) with no history kept. PTT is refused
+// (RADIO_BLOCKED) once the bucket is empty, and a transmission that runs it
+// dry is ended just like a TOT.
+//
+// Tokens are ms * 100, so a percentage of a millisecond is still a whole number.
+//
+struct RadioDuty {
+   uint32_t	pct;			// allowed duty cycle, 0 = no limit
+   uint64_t	window_ms;		// ... over this long
+   int64_t	tokens;			// TX time left (ms * 100)
+   uint64_t	updated;		// when tokens was last brought up to date (radio_now_ms)
+   switch_bool_t tx;			// draining
+   RadioTimer_t	timer;			// bucket runs dry mid-TX
+};
+typedef struct RadioDuty RadioDuty_t;
+
+// Set the limit (config), fills the bucket
+extern void radio_duty_configure(const int radio, const uint32_t pct, const uint64_t window_ms);
+
+// Can we key up? Starts draining if so (state machine only)
+extern switch_bool_t radio_duty_tx_start(const int radio);
+extern void radio_duty_tx_end(const int radio);
+
+// Seconds of full-power TX left right now, -1 if there's no limit
+extern time_t radio_duty_remaining(const int radio);
+
+// "600", "600s", "10m", "1h" -> ms, 0 if it doesn't parse
+extern uint64_t radio_duty_parse_window(const char *val);
+
+#endif	// !defined(RADIO_DUTY_H)
@@ -9,10 +9,22 @@
 
 static void radio_reload_configuration(switch_event_t *evt) {
    radio_load_configuration(true);
+   radio_rcu_reclaim();
 }
 
+// Debug tap: at most event_tap_rate events a second get dumped, the rest are counted
+static struct {
+   int64_t	second;			// which second we're counting
+   int		count;			// dumped this second
+   uint64_t	dropped;		// skipped since the last report
+} tap;
+
 // Just dump the event information - this is useful for instrumenting new events */
 static void radio_cry_event(switch_event_t *evt) {
+   int64_t now = (int64_t)(radio_now_ms() / 1000), second = __atomic_load_n(&tap.second, __ATOMIC_RELAXED);
+   uint64_t dropped;
+   const int64_t rate = dconf_int(CFGH_EVENT_TAP_RATE);
+
    // Exclude some excessively noisy, yet useless events
    if ((evt->event_id == SWITCH_EVENT_HEARTBEAT) ||
        (evt->event_id == SWITCH_EVENT_RE_SCHEDULE) ||
@@ -23,6 +35,20 @@ static void radio_cry_event(switch_event_t *evt) {
       return;
    }
 
+   // New second, whoever gets here first resets the budget
+   if (now != second && __atomic_compare_exchange_n(&tap.second, &second, now, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      __atomic_store_n(&tap.count, 0, __ATOMIC_RELAXED);
+
+      if ((dropped = __atomic_exchange_n(&tap.dropped, 0, __ATOMIC_RELAXED)) > 0) {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "[events] tap skipped %" PRIu64 " events (event_tap_rate %ld/s)\n", dropped, (long)rate);
+      }
+   }
+
+   if (__atomic_add_fetch(&tap.count, 1, __ATOMIC_RELAXED) > rate) {
+      __atomic_add_fetch(&tap.dropped, 1, __ATOMIC_RELAXED);
+      return;
+   }
+
    switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "--Unhandled Event--\n");
    switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Key: %lu Flags: %i\n", evt->key, evt->flags);
    switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "ID: %s Subclass: %s Priority: %03i \n", switch_event_name(evt->event_id), evt->subclass_name, evt->priority);
@@ -31,79 +57,97 @@ static void radio_cry_event(switch_event_t *evt) {
    switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "--Unhandled Event--\n");
 }
 
-// Here we map each event + subclass to it's handler function, so radio_events_init
-// can set it up in freeswitch
+// Here we map each event + subclass to it's handler function. Only the ones
+// named in [general] events= (default: reloadxml) are bound by radio_events_init,
+// so call traffic we don't care about never reaches us.
 static RadioEvent_t radio_events[] = {
+   // Reload the configuration
+   { "reloadxml", SWITCH_EVENT_RELOADXML, SWITCH_EVENT_SUBCLASS_ANY, radio_reload_configuration },
+
    ////////////////////
    // Audio activity //
    ////////////////////
-
-   // log all events... This is extremely verbose and likely only useful for developers ;)
-   { SWITCH_EVENT_ALL, SWITCH_EVENT_SUBCLASS_ANY, radio_cry_event },
-#if	0
-   // Speech activity detected
-   { SWITCH_EVENT_DETECTED_SPEECH, SWITCH_EVENT_SUBCLASS_ANY, radio_cry_event },
-   // Detected tones (not DTMF?)
-   { SWITCH_EVENT_DETECTED_TONE, SWITCH_EVENT_SUBCLASS_ANY, radio_cry_event },
-   // Detected DTMF
-   { SWITCH_EVENT_DTMF, SWITCH_EVENT_SUBCLASS_ANY, radio_cry_event },
+   // XXX: These only go to the tap until VOX/DTMF control is wired up
    // Audio is coming in
-   { SWITCH_EVENT_TALK, SWITCH_EVENT_SUBCLASS_ANY, radio_cry_event },
+   { "talk", SWITCH_EVENT_TALK, SWITCH_EVENT_SUBCLASS_ANY, radio_cry_event },
    // Audio has ended
-   { SWITCH_EVENT_NOTALK, SWITCH_EVENT_SUBCLASS_ANY, radio_cry_event },
-#endif
-   // Reload the configuration
-   { SWITCH_EVENT_RELOADXML, SWITCH_EVENT_SUBCLASS_ANY, radio_reload_configuration },
+   { "notalk", SWITCH_EVENT_NOTALK, SWITCH_EVENT_SUBCLASS_ANY, radio_cry_event },
+   // Detected DTMF
+   { "dtmf", SWITCH_EVENT_DTMF, SWITCH_EVENT_SUBCLASS_ANY, radio_cry_event },
+   // Detected tones (not DTMF?)
+   { "detected_tone", SWITCH_EVENT_DETECTED_TONE, SWITCH_EVENT_SUBCLASS_ANY, radio_cry_event },
 
-#if	0
-   ////////////////////
-   // Channel Events //
-   ////////////////////
-   { SWITCH_EVENT_CHANNEL_CREATE, SWITCH_EVENT_SUBCLASS_ANY, radio_cry_event },
-   { SWITCH_EVENT_CHANNEL_DESTROY, SWITCH_EVENT_SUBCLASS_ANY, radio_cry_event },
-   { SWITCH_EVENT_CHANNEL_STATE, SWITCH_EVENT_SUBCLASS_ANY, radio_cry_event },
-   { SWITCH_EVENT_CHANNEL_CALLSTATE, SWITCH_EVENT_SUBCLASS_ANY, radio_cry_event },
-   { SWITCH_EVENT_CHANNEL_BRIDGE, SWITCH_EVENT_SUBCLASS_ANY, radio_cry_event },
-   { SWITCH_EVENT_CHANNEL_UNBRIDGE, SWITCH_EVENT_SUBCLASS_ANY, radio_cry_event },
-   { SWITCH_EVENT_CHANNEL_HANGUP, SWITCH_EVENT_SUBCLASS_ANY, radio_cry_event },
-#endif
+   /////////////////
+   // Conferences //
+   /////////////////
+   { "conference", SWITCH_EVENT_CUSTOM, "conference::maintenance", radio_cry_event },
+
+   // Everything, for instrumenting new events (event_tap=true, debug builds of your config only!)
+   { "tap", SWITCH_EVENT_ALL, SWITCH_EVENT_SUBCLASS_ANY, radio_cry_event },
 
    // Terminating element - Do not modify.
-   { 0, NULL, NULL }
+   { NULL, 0, NULL, NULL }
 };
 
-// Register all our event hooks
+// Is name in the comma separated list?
+static switch_bool_t radio_event_wanted(const char *list, const char *name) {
+   size_t len = strlen(name);
+
+   for (const char *p = list; p && *p; ) {
+      while (*p == ',' || *p == ' ') {
+         p++;
+      }
+
+      if (strncasecmp(p, name, len) == 0 && (p[len] == '\0' || p[len] == ',' || p[len] == ' ')) {
+         return true;
+      }
+
+      p = strchr(p, ',');
+   }
+
+   return false;
+}
+
+// Register the event hooks the configuration asks for
 void radio_events_init(void) {
+   CfgGeneral_t *cfg = dconf_hold();
+   const char *wanted = dconf_str(cfg, "events", "reloadxml");
+   switch_bool_t want_tap = dconf_bool(CFGH_EVENT_TAP);
+
    // bind all events we care about
-   for (int i = 0; i < (sizeof(radio_events) / sizeof(RadioEvent_t)); i++) {
-      // last element, exit the loop
-      if (radio_events[i].event_type == 0 && radio_events[i].event_subclass == NULL && radio_events[i].event_handler == NULL) {
-         break;
+   for (RadioEvent_t *e = radio_events; e->name != NULL; e++) {
+      // If no handler, this event is disabled
+      if (e->event_handler == NULL) {
+         continue;
       }
 
-      // If no handler, this event is disabled
-      if (radio_events[i].event_handler == NULL) {
+      if (strcmp(e->name, "tap") == 0 ? !want_tap : !radio_event_wanted(wanted, e->name)) {
          continue;
       }
 
       // Hook the event
-      if ((switch_event_bind(globals.modname, radio_events[i].event_type, radio_events[i].event_subclass, radio_events[i].event_handler, NULL) != SWITCH_STATUS_SUCCESS)) {
-         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind event %s:%s handler!", switch_event_name(radio_events[i].event_type), (radio_events[i].event_subclass != NULL ? radio_events[i].event_subclass : ""));
+      if ((switch_event_bind(globals.modname, e->event_type, e->event_subclass, e->event_handler, NULL) != SWITCH_STATUS_SUCCESS)) {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind event %s:%s handler!", switch_event_name(e->event_type), (e->event_subclass != NULL ? e->event_subclass : ""));
          break;
       }
+
+      e->bound = true;
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "[events] bound %s\n", e->name);
+   }
+
+   if (want_tap) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "[events] event_tap is on, every switch event passes through mod_hamradio (max %ld/s logged)\n", (long)dconf_int(CFGH_EVENT_TAP_RATE));
    }
+
+   dconf_release(cfg);
 }
 
 // Unregister event hooks
 void radio_events_fini(void) {
-   for (int i = 0; i < (sizeof(radio_events) / sizeof(RadioEvent_t)); i++) {
-      // last element, exit the loop
-      if (radio_events[i].event_type == 0 && radio_events[i].event_subclass == NULL && radio_events[i].event_handler == NULL) {
-         break;
-      }
-
-      if (radio_events[i].event_handler != NULL) {
-         switch_event_unbind_callback(radio_events[i].event_handler);
+   for (RadioEvent_t *e = radio_events; e->name != NULL; e++) {
+      if (e->bound) {
+         switch_event_unbind_callback(e->event_handler);
+         e->bound = false;
       }
    }
 }
@@ -0,0 +1,102 @@
+/*
+ * Radio state transition table
+ *
+ * Rows are the state we're leaving, columns the one we're going to. Moves
+ * that make no physical sense are left out (all zero) and get refused:
+ * nothing is received or transmitted without power, so OFF only goes to
+ * IDLE, and a squelch opening never cuts a transmission short (TX -> RX).
+ * Staying put never gets this far (radio_set_state returns early).
+ */
+#include "mod_hamradio.h"
+
+// Line levels for each kind of destination
+#define	LINES_OFF	.ptt = FSM_LINE_OFF, .power = FSM_LINE_OFF
+#define	LINES_ON	.ptt = FSM_LINE_OFF, .power = FSM_LINE_ON
+#define	LINES_TX	.ptt = FSM_LINE_ON,  .power = FSM_LINE_KEEP
+
+// Every real change
+#define	CHANGE		(FSM_VALID | FSM_NOTIFY)
+
+// Keying up from a receiver that isn't transmitting
+#define	KEY_UP		(CHANGE | FSM_PTT_REQUEST | FSM_PENALTY_CHECK | FSM_DUTY_START | FSM_TALK_START | FSM_ID_ARM)
+
+// Dropping out of TX (or TX_DATA): the transmission is over, record it
+#define	UNKEY		(CHANGE | FSM_TOT_CANCEL | FSM_DUTY_END | FSM_TALK_END | FSM_TALK_CLEAR)
+
+const RadioTransition_t radio_transitions[RADIO_STATES][RADIO_STATES] = {
+   [RADIO_OFF] = {
+      [RADIO_OFF]     = { FSM_VALID, LINES_OFF },
+      [RADIO_IDLE]    = { CHANGE | FSM_TALK_CLEAR, LINES_ON },
+   },
+   [RADIO_IDLE] = {
+      [RADIO_OFF]     = { CHANGE, LINES_OFF },
+      [RADIO_IDLE]    = { FSM_VALID, LINES_ON },
+      [RADIO_RX]      = { CHANGE | FSM_LISTEN_START, LINES_ON },
+      [RADIO_TX]      = { KEY_UP | FSM_TOT_ARM, LINES_TX },
+      [RADIO_TX_DATA] = { KEY_UP, LINES_TX },
+   },
+   [RADIO_RX] = {
+      [RADIO_OFF]     = { CHANGE | FSM_LISTEN_END, LINES_OFF },
+      [RADIO_IDLE]    = { CHANGE | FSM_LISTEN_END | FSM_TALK_CLEAR, LINES_ON },
+      [RADIO_RX]      = { FSM_VALID, LINES_ON },
+      [RADIO_TX]      = { KEY_UP | FSM_LISTEN_END | FSM_TOT_ARM, LINES_TX },
+      [RADIO_TX_DATA] = { KEY_UP | FSM_LISTEN_END, LINES_TX },
+   },
+   [RADIO_TX] = {
+      [RADIO_OFF]     = { UNKEY, LINES_OFF },
+      [RADIO_IDLE]    = { UNKEY, LINES_ON },
+      [RADIO_TX]      = { FSM_VALID, LINES_TX },
+      // Still keyed: the talk clock, duty cycle and ID keep running, only the TOT stops
+      [RADIO_TX_DATA] = { CHANGE | FSM_PENALTY_CHECK | FSM_TOT_CANCEL | FSM_ID_ARM, LINES_TX },
+   },
+   [RADIO_TX_DATA] = {
+      [RADIO_OFF]     = { UNKEY, LINES_OFF },
+      [RADIO_IDLE]    = { UNKEY, LINES_ON },
+      [RADIO_TX]      = { CHANGE | FSM_PENALTY_CHECK | FSM_TALK_START | FSM_TOT_ARM | FSM_ID_ARM, LINES_TX },
+      [RADIO_TX_DATA] = { FSM_VALID, LINES_TX },
+   },
+};
+
+static const char *fsm_line(const int8_t level) {
+   return (level == FSM_LINE_KEEP ? "-" : (level == FSM_LINE_ON ? "on" : "off"));
+}
+
+void radio_fsm_print(switch_stream_handle_t *stream) {
+   static const struct {
+      uint32_t flag;
+      const char *name;
+   } names[] = {
+      { FSM_NOTIFY, "notify" }, { FSM_PTT_REQUEST, "ptt_request" }, { FSM_PENALTY_CHECK, "penalty_check" },
+      { FSM_DUTY_START, "duty_start" }, { FSM_DUTY_END, "duty_end" }, { FSM_TOT_CANCEL, "tot_cancel" },
+      { FSM_TALK_START, "talk_start" }, { FSM_TOT_ARM, "tot_arm" }, { FSM_TALK_END, "talk_end" },
+      { FSM_TALK_CLEAR, "talk_clear" }, { FSM_LISTEN_START, "listen_start" }, { FSM_LISTEN_END, "listen_end" },
+      { FSM_ID_ARM, "id_arm" }
+   };
+
+   for (int old = RADIO_OFF; old < RADIO_STATES; old++) {
+      for (int new = RADIO_OFF; new < RADIO_STATES; new++) {
+         const RadioTransition_t *t = radio_transition(old, new);
+
+         if (old == new) {
+            continue;
+         }
+
+         stream->write_function(stream, "%-12s -> %-12s ", radio_status_name(old), radio_status_name(new));
+
+         if (!(t->actions & FSM_VALID)) {
+            stream->write_function(stream, "refused\n");
+            continue;
+         }
+
+         stream->write_function(stream, "ptt=%s power=%s", fsm_line(t->ptt), fsm_line(t->power));
+
+         for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+            if (t->actions & names[i].flag) {
+               stream->write_function(stream, " %s", names[i].name);
+            }
+         }
+
+         stream->write_function(stream, "\n");
+      }
+   }
+}
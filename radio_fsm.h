@@ -0,0 +1,53 @@
+#if	!defined(RADIO_FSM_H)
+#define	RADIO_FSM_H
+
+//
+// Radio state transitions
+//
+// Everything radio_set_state() does when moving between two states is
+// decided once, here, in a constant table indexed by [old][new]: whether
+// the move is allowed at all, which lines change, and which clocks, timers
+// and counters get touched. radio_set_state() looks the entry up, refuses
+// anything not marked FSM_VALID before touching the radio, then just runs
+// the actions, queueing the line changes into one batched GPIO write.
+//
+#define	RADIO_STATES		(RADIO_TX_DATA + 1)
+
+enum RadioFsmAction {
+   FSM_VALID		= (1 << 0),	// transition is allowed at all
+   FSM_NOTIFY		= (1 << 1),	// trace it and raise hamradio::state
+   FSM_PTT_REQUEST	= (1 << 2),	// start the PTT latency clock
+   FSM_PENALTY_CHECK	= (1 << 3),	// refuse (and extend) while a TOT penalty is running
+   FSM_DUTY_START	= (1 << 4),	// refuse without duty cycle budget, else start spending it
+   FSM_DUTY_END		= (1 << 5),	// stop spending duty cycle budget
+   FSM_TOT_CANCEL	= (1 << 6),	// stop the TOT clock
+   FSM_TALK_START	= (1 << 7),	// start the talk clock, unless it's running already
+   FSM_TOT_ARM		= (1 << 8),	// arm the TOT for what the talk clock has left
+   FSM_TALK_END		= (1 << 9),	// record the transmission (total_tx, last_tx)
+   FSM_TALK_CLEAR	= (1 << 10),	// reset the talk clock
+   FSM_LISTEN_START	= (1 << 11),	// start the receive clock
+   FSM_LISTEN_END	= (1 << 12),	// record the reception (total_rx, last_rx)
+   FSM_ID_ARM		= (1 << 13)	// start counting down to the next ID, unless already
+};
+
+// Line levels: FSM_LINE_KEEP leaves the line alone
+#define	FSM_LINE_KEEP		-1
+#define	FSM_LINE_OFF		0
+#define	FSM_LINE_ON		1
+
+struct RadioTransition {
+   uint32_t	actions;		// FSM_* flags
+   int8_t	ptt;			// FSM_LINE_*
+   int8_t	power;
+};
+typedef struct RadioTransition RadioTransition_t;
+
+extern const RadioTransition_t radio_transitions[RADIO_STATES][RADIO_STATES];
+
+// Entry for old -> new, old and new must be valid (non-negative) states
+#define	radio_transition(old, new)	(&radio_transitions[(old)][(new)])
+
+// Dump the table (hamradio transitions)
+extern void radio_fsm_print(switch_stream_handle_t *stream);
+
+#endif	// !defined(RADIO_FSM_H)
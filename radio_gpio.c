@@ -3,6 +3,18 @@
  *
  * Here we try to provide support for multiple GPIO chips with lines attached
  * to them. We support this by using chip:pin syntax in the configuration.
+ *
+ * All of the power and PTT outputs on a chip, for every radio, are held in a
+ * single line request, so there is one fd per chip no matter how many radios
+ * are attached. Output changes are collected in a GPIOBatch_t and written with
+ * one set_values_subset() call, which keys a group of radios in one ioctl with
+ * no skew between the lines. A rebuild that only changes which radio (or which
+ * polarity) is on a line reconfigures the request in place; it is only
+ * released and requested again, with every output preset to its current
+ * level, when lines are added or dropped. The squelch inputs share a request
+ * of their own, which is the runtime thread's edge fd; an input drives
+ * nothing, so re-requesting it when the set of squelch lines changes is
+ * harmless.
  */
 #include <switch.h>
 #include <gpiod.h>
@@ -11,19 +23,42 @@
 //////////////////////
 // GPIO chip globals //
 //////////////////////
+// What an output line is being used for, so a rebuild can tell what changed
+struct GPIOOutput {
+   switch_bool_t held;			// in the output request
+   int		radio;			// whose line it is
+   switch_bool_t invert;
+   switch_bool_t on;			// level to preset when (re)configuring
+};
+
+struct GPIOChip {
+   struct gpiod_chip *chip;
+   struct gpiod_line_request *out;	// every power/PTT output on this chip
+   struct gpiod_line_request *req;	// every squelch input on this chip
+   size_t lines;			// how many lines are in out and req
+   uint8_t	inputs[MAX_GPIO + 1];	// which offsets req holds
+   struct GPIOOutput outputs[MAX_GPIO + 1];
+};
 
 // still single-chip for now
-static struct gpiod_chip *gpiochip = NULL;
+static struct GPIOChip gpiochip;
+
+// Counted with relaxed atomics, for hamradio metrics
+static GPIOStats_t gpio_stats;
+
+// Edge events read from squelch lines land here (only used by the runtime thread)
+#define	SQUELCH_EVENT_BUF	16
+static struct gpiod_edge_event_buffer *squelch_events = NULL;
 
 struct gpiod_chip *radio_find_gpiochip(const char *name) {
    (void)name;
-   return gpiochip;
+   return gpiochip.chip;
 }
 
 int radio_gpiochip_init(const char *chipname) {
    char path[64];
 
-   if (gpiochip) {
+   if (gpiochip.chip) {
       switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING,
                         "[gpio] chip already initialized\n");
       return SWITCH_STATUS_SUCCESS;
@@ -39,223 +74,391 @@ int radio_gpiochip_init(const char *chipname) {
    switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE,
                      "[gpio] opening chip %s\n", path);
 
-   gpiochip = gpiod_chip_open(path);
+   gpiochip.chip = gpiod_chip_open(path);
 
-   if (!gpiochip) {
+   if (!gpiochip.chip) {
       switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR,
                         "[gpio] failed to open %s\n", path);
       return SWITCH_STATUS_TERM;
    }
 
+   if (!squelch_events) {
+      squelch_events = gpiod_edge_event_buffer_new(SQUELCH_EVENT_BUF);
+   }
+
    return SWITCH_STATUS_SUCCESS;
 }
 
 //////////////////////
-// helper requests   //
+// line request     //
 //////////////////////
 
-static struct gpiod_line_request *
-gpio_request_output(unsigned int offset,
-                    const char *consumer,
-                    int value) {
-   struct gpiod_line_settings *st;
+// Let go of the output request (the lines' levels are up to the driver from here on)
+static void gpio_release_outputs(void) {
+   if (gpiochip.out) {
+      gpiod_line_request_release(gpiochip.out);
+      gpiochip.out = NULL;
+   }
+
+   for (int offset = 0; offset <= MAX_GPIO; offset++) {
+      gpiochip.lines -= gpiochip.outputs[offset].held;
+   }
+   memset(gpiochip.outputs, 0, sizeof(gpiochip.outputs));
+}
+
+// Claim an output line for a radio, starting out on or off
+static int gpio_want_output(struct GPIOOutput *want, const int radio, const int offset,
+                            const switch_bool_t invert, const switch_bool_t on) {
+   if (offset < 0 || offset > MAX_GPIO || want[offset].held) {
+      return -1;
+   }
+
+   want[offset].held = true;
+   want[offset].radio = radio;
+   want[offset].invert = invert;
+   want[offset].on = on;
+   return 0;
+}
+
+// Outputs every radio wants, at the level matching its current state
+static void gpio_wanted_outputs(struct GPIOOutput *want) {
+   memset(want, 0, sizeof(*want) * (MAX_GPIO + 1));
+
+   for (int radio = 0; radio < globals.max_radios; radio++) {
+      if (!radio_exists(radio)) {
+         continue;
+      }
+
+      Radio_t *r = &Radios(radio);
+
+      if (r->pin_power >= 0 && gpio_want_output(want, radio, r->pin_power, r->pin_power_invert, (r->status != RADIO_OFF)) < 0) {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR,
+                           "[gpio] radio %d power line %d is invalid or already in use\n", radio, r->pin_power);
+      }
+
+      if (r->pin_ptt >= 0 && gpio_want_output(want, radio, r->pin_ptt, r->pin_ptt_invert, (r->status == RADIO_TX || r->status == RADIO_TX_DATA)) < 0) {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR,
+                           "[gpio] radio %d ptt line %d is invalid or already in use\n", radio, r->pin_ptt);
+      }
+   }
+}
+
+// Line config for the outputs in want[], each preset to its level. Returns the number of lines
+static size_t gpio_output_config(struct gpiod_line_config *cfg, const struct GPIOOutput *want) {
+   struct gpiod_line_settings *out;
+   size_t lines = 0;
+
+   out = gpiod_line_settings_new();
+   gpiod_line_settings_set_direction(out, GPIOD_LINE_DIRECTION_OUTPUT);
+
+   for (unsigned int offset = 0; offset <= MAX_GPIO; offset++) {
+      if (!want[offset].held) {
+         continue;
+      }
+
+      gpiod_line_settings_set_output_value(out,
+         (want[offset].on != want[offset].invert) ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE);
+
+      // settings are copied, so it's fine to change out for the next line
+      if (gpiod_line_config_add_line_settings(cfg, &offset, 1, out) == 0) {
+         lines++;
+      }
+   }
+
+   gpiod_line_settings_free(out);
+   return lines;
+}
+
+// Put the outputs in want[] in place: reconfigure the request if it already
+// holds exactly those lines, otherwise request them again
+static const char *gpio_apply_outputs(const struct GPIOOutput *want, const switch_bool_t same_lines) {
    struct gpiod_line_config *cfg;
    struct gpiod_request_config *rcfg;
-   struct gpiod_line_request *req;
-   unsigned int offs[1] = { offset };
+   const char *what = "reconfigured";
+   size_t lines;
 
-   st = gpiod_line_settings_new();
-   gpiod_line_settings_set_direction(st, GPIOD_LINE_DIRECTION_OUTPUT);
+   cfg = gpiod_line_config_new();
+   lines = gpio_output_config(cfg, want);
 
-   gpiod_line_settings_set_output_value(
-      st,
-      value ? GPIOD_LINE_VALUE_ACTIVE
-            : GPIOD_LINE_VALUE_INACTIVE);
+   if (same_lines && gpiochip.out) {
+      if (gpiod_line_request_reconfigure_lines(gpiochip.out, cfg) < 0) {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR,
+                           "[gpio] reconfiguring output lines failed: %s\n", strerror(errno));
+         what = "unchanged (reconfigure failed)";
+      } else {
+         memcpy(gpiochip.outputs, want, sizeof(gpiochip.outputs));
+      }
+   } else if (lines > 0) {
+      what = "re-requested";
+      rcfg = gpiod_request_config_new();
+      gpiod_request_config_set_consumer(rcfg, "hamradio");
+      gpiochip.out = gpiod_chip_request_lines(gpiochip.chip, rcfg, cfg);
+      gpiod_request_config_free(rcfg);
+
+      // Busy means someone else entirely already has one of them
+      if (!gpiochip.out) {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR,
+                           "[gpio] output line request failed: %s\n", strerror(errno));
+         what = "not held (request failed)";
+      } else {
+         memcpy(gpiochip.outputs, want, sizeof(gpiochip.outputs));
+         gpiochip.lines += lines;
+      }
+   } else {
+      what = "released";
+   }
 
-   cfg = gpiod_line_config_new();
-   gpiod_line_config_add_line_settings(cfg, offs, 1, st);
+   gpiod_line_config_free(cfg);
+   return what;
+}
+
+// Squelch lines every radio wants, true if that's not what the input request holds
+static switch_bool_t gpio_wanted_inputs(uint8_t *want, const struct GPIOOutput *outputs) {
+   memset(want, 0, MAX_GPIO + 1);
 
-   rcfg = gpiod_request_config_new();
-   gpiod_request_config_set_consumer(rcfg, consumer);
+   for (int radio = 0; radio < globals.max_radios; radio++) {
+      if (!radio_exists(radio)) {
+         continue;
+      }
 
-   req = gpiod_chip_request_lines(gpiochip, rcfg, cfg);
+      Radio_t *r = &Radios(radio);
 
-   gpiod_request_config_free(rcfg);
-   gpiod_line_config_free(cfg);
-   gpiod_line_settings_free(st);
+      if (r->RX_mode != SQUELCH_GPIO || r->pin_squelch < 0) {
+         continue;
+      }
+
+      if (r->pin_squelch > MAX_GPIO || outputs[r->pin_squelch].held) {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR,
+                           "[gpio] radio %d squelch line %d is invalid or used as an output\n", radio, r->pin_squelch);
+         continue;
+      }
+
+      // Radios are allowed to share one (receiver diversity, etc)
+      want[r->pin_squelch] = 1;
+   }
 
-   return req;
+   return (memcmp(want, gpiochip.inputs, MAX_GPIO + 1) != 0);
 }
 
-static struct gpiod_line_request *
-gpio_request_input(unsigned int offset,
-                   const char *consumer) {
-   struct gpiod_line_settings *st;
+// Request the squelch inputs in want[], replacing the old request
+static void gpio_request_inputs(const uint8_t *want) {
+   struct gpiod_line_settings *in;
    struct gpiod_line_config *cfg;
    struct gpiod_request_config *rcfg;
-   struct gpiod_line_request *req;
-   unsigned int offs[1] = { offset };
+   size_t lines = 0;
 
-   st = gpiod_line_settings_new();
-   gpiod_line_settings_set_direction(st, GPIOD_LINE_DIRECTION_INPUT);
+   in = gpiod_line_settings_new();
+   gpiod_line_settings_set_direction(in, GPIOD_LINE_DIRECTION_INPUT);
 
-   cfg = gpiod_line_config_new();
-   gpiod_line_config_add_line_settings(cfg, offs, 1, st);
+   // Ask the kernel to queue both edges for us, so the runtime thread can
+   // sleep on the request fd instead of polling the line level
+   gpiod_line_settings_set_edge_detection(in, GPIOD_LINE_EDGE_BOTH);
+   gpiod_line_settings_set_event_clock(in, GPIOD_LINE_CLOCK_MONOTONIC);
 
-   rcfg = gpiod_request_config_new();
-   gpiod_request_config_set_consumer(rcfg, consumer);
+   cfg = gpiod_line_config_new();
 
-   req = gpiod_chip_request_lines(gpiochip, rcfg, cfg);
+   for (unsigned int offset = 0; offset <= MAX_GPIO; offset++) {
+      if (want[offset] && gpiod_line_config_add_line_settings(cfg, &offset, 1, in) == 0) {
+         lines++;
+      }
+   }
 
-   gpiod_request_config_free(rcfg);
-   gpiod_line_config_free(cfg);
-   gpiod_line_settings_free(st);
+   if (lines > 0) {
+      rcfg = gpiod_request_config_new();
+      gpiod_request_config_set_consumer(rcfg, "hamradio");
+      gpiochip.req = gpiod_chip_request_lines(gpiochip.chip, rcfg, cfg);
+      gpiod_request_config_free(rcfg);
 
-   return req;
-}
+      if (!gpiochip.req) {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR,
+                           "[gpio] squelch line request failed (is one of them used as an output?): %s\n", strerror(errno));
+      }
+   }
 
-//////////////////////
-// radio init        //
-//////////////////////
-int radio_gpio_init(const int radio) {
-   Radio_t *r;
+   gpiod_line_config_free(cfg);
+   gpiod_line_settings_free(in);
 
-   if (radio < 0 || radio >= globals.max_radios) {
-      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR,
-                        "[gpio] invalid radio %d\n", radio);
-      return SWITCH_STATUS_FALSE;
+   if (gpiochip.req) {
+      memcpy(gpiochip.inputs, want, MAX_GPIO + 1);
+      gpiochip.lines += lines;
    }
+}
 
-   r = &Radios(radio);
+// Bring the requests in line with the radio table, only touching what changed.
+// Table writers only (see radio_table.h); the caller bumps gpio_generation so
+// the runtime thread picks up a new squelch fd.
+static int gpio_sync(void) {
+   struct GPIOOutput want_out[MAX_GPIO + 1];
+   uint8_t want_in[MAX_GPIO + 1];
+   switch_bool_t same_lines = true, outputs_changed = false, inputs_changed;
+   const char *outputs = "unchanged";
 
-   if (!gpiochip) {
+   if (!gpiochip.chip) {
       switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR,
                         "[gpio] chip not initialized\n");
       return SWITCH_STATUS_FALSE;
    }
 
-   //////////////////////
-   // POWER GPIO       //
-   //////////////////////
-   if (r->pin_power >= 0) {
-      r->gpio_power =
-         gpio_request_output(r->pin_power,
-                             "hamradio-power",
-                             r->pin_power_invert ? 1 : 0);
+   gpio_wanted_outputs(want_out);
+   inputs_changed = gpio_wanted_inputs(want_in, want_out);
 
-      if (!r->gpio_power) {
-         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR,
-                           "[gpio] radio %d power request failed\n", radio);
-         return SWITCH_STATUS_FALSE;
+   for (int offset = 0; offset <= MAX_GPIO; offset++) {
+      const struct GPIOOutput *have = &gpiochip.outputs[offset], *want = &want_out[offset];
+
+      if (have->held != want->held) {
+         same_lines = false;
+         outputs_changed = true;
+      } else if (want->held && (have->radio != want->radio || have->invert != want->invert)) {
+         outputs_changed = true;
       }
    }
 
-   //////////////////////
-   // PTT GPIO         //
-   //////////////////////
-   if (r->pin_ptt >= 0) {
-      r->gpio_ptt =
-         gpio_request_output(r->pin_ptt,
-                             "hamradio-ptt",
-                             r->pin_ptt_invert ? 1 : 0);
+   // Let go of everything that's going away first, so a line can move
+   // between a squelch input and an output in one go
+   if (!same_lines) {
+      gpio_release_outputs();
+   }
 
-      if (!r->gpio_ptt) {
-         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR,
-                           "[gpio] radio %d ptt request failed\n", radio);
-         return SWITCH_STATUS_FALSE;
+   if (inputs_changed && gpiochip.req) {
+      gpiod_line_request_release(gpiochip.req);
+      gpiochip.req = NULL;
+
+      for (int offset = 0; offset <= MAX_GPIO; offset++) {
+         gpiochip.lines -= gpiochip.inputs[offset];
       }
+      memset(gpiochip.inputs, 0, sizeof(gpiochip.inputs));
    }
 
-   //////////////////////
-   // SQUELCH INPUT    //
-   //////////////////////
-   if (r->pin_squelch >= 0 && r->RX_mode == SQUELCH_GPIO) {
-      r->gpio_squelch =
-         gpio_request_input(r->pin_squelch,
-                            "hamradio-squelch");
+   if (outputs_changed) {
+      outputs = gpio_apply_outputs(want_out, same_lines);
+   }
 
-      if (!r->gpio_squelch) {
-         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR,
-                           "[gpio] radio %d squelch request failed\n", radio);
-         return SWITCH_STATUS_FALSE;
+   if (inputs_changed) {
+      gpio_request_inputs(want_in);
+   }
+
+   // Point each radio at the requests holding its lines
+   for (int radio = 0; radio < globals.max_radios; radio++) {
+      if (!radio_exists(radio)) {
+         continue;
       }
+
+      Radio_t *r = &Radios(radio);
+
+      r->gpio_power = (gpiochip.out && r->pin_power >= 0 && r->pin_power <= MAX_GPIO &&
+                       gpiochip.outputs[r->pin_power].held && gpiochip.outputs[r->pin_power].radio == radio) ? gpiochip.out : NULL;
+      r->gpio_ptt = (gpiochip.out && r->pin_ptt >= 0 && r->pin_ptt <= MAX_GPIO &&
+                     gpiochip.outputs[r->pin_ptt].held && gpiochip.outputs[r->pin_ptt].radio == radio) ? gpiochip.out : NULL;
+      r->gpio_squelch = (gpiochip.req && r->RX_mode == SQUELCH_GPIO && r->pin_squelch >= 0 && r->pin_squelch <= MAX_GPIO && gpiochip.inputs[r->pin_squelch]) ? gpiochip.req : NULL;
+
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG,
+                        "[gpio] radio %d lines (pwr=%s ptt=%s sq=%s)\n",
+                        radio,
+                        r->gpio_power ? "yes" : "no",
+                        r->gpio_ptt ? "yes" : "no",
+                        r->gpio_squelch ? "yes" : "no");
    }
 
    switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE,
-                     "[gpio] radio %d init done (pwr=%p ptt=%p sq=%p)\n",
-                     radio,
-                     r->gpio_power,
-                     r->gpio_ptt,
-                     r->gpio_squelch);
+                     "[gpio] %lu lines held, outputs %s, squelch inputs %s\n",
+                     (unsigned long)gpiochip.lines, outputs, (inputs_changed ? "re-requested" : "unchanged"));
 
    return SWITCH_STATUS_SUCCESS;
 }
 
+// Request every configured line of every radio. Outputs start out matching
+// each radio's state (all off at load)
+int radio_gpio_init(void) {
+   return gpio_sync();
+}
+
+// Radios came, went or changed pins: keep the chip open, reconfigure the
+// outputs in place unless lines were added or dropped, and leave every other
+// radio's outputs at the level they're at
+int radio_gpio_rebuild(void) {
+   return gpio_sync();
+}
+
+// Would these two radios get different lines (or line settings) from radio_gpio_init()?
+switch_bool_t radio_gpio_differs(const Radio_t *a, const Radio_t *b) {
+   return (a->pin_power != b->pin_power || a->pin_power_invert != b->pin_power_invert ||
+           a->pin_ptt != b->pin_ptt || a->pin_ptt_invert != b->pin_ptt_invert ||
+           a->pin_squelch != b->pin_squelch || a->RX_mode != b->RX_mode);
+}
+
 //////////////////////
 // cleanup           //
 //////////////////////
 
 switch_status_t radio_gpio_fini(void) {
-   if (!gpiochip) {
+   if (!gpiochip.chip) {
       return SWITCH_STATUS_SUCCESS;
    }
 
    for (int i = 0; i < globals.max_radios; i++) {
+      if (!radio_exists(i)) {
+         continue;
+      }
+
       Radio_t *r = &Radios(i);
 
-      if (r->gpio_power) {
-         gpiod_line_request_release(r->gpio_power);
-         r->gpio_power = NULL;
-      }
+      r->gpio_power = NULL;
+      r->gpio_ptt = NULL;
+      r->gpio_squelch = NULL;
+   }
 
-      if (r->gpio_ptt) {
-         gpiod_line_request_release(r->gpio_ptt);
-         r->gpio_ptt = NULL;
-      }
+   gpio_release_outputs();
 
-      if (r->gpio_squelch) {
-         gpiod_line_request_release(r->gpio_squelch);
-         r->gpio_squelch = NULL;
-      }
+   if (gpiochip.req) {
+      gpiod_line_request_release(gpiochip.req);
+      gpiochip.req = NULL;
    }
 
-   gpiod_chip_close(gpiochip);
-   gpiochip = NULL;
+   memset(gpiochip.inputs, 0, sizeof(gpiochip.inputs));
+   gpiochip.lines = 0;
+
+   gpiod_chip_close(gpiochip.chip);
+   gpiochip.chip = NULL;
+
+   if (squelch_events) {
+      gpiod_edge_event_buffer_free(squelch_events);
+      squelch_events = NULL;
+   }
 
    return SWITCH_STATUS_SUCCESS;
 }
 
 //////////////////////
-// control helpers   //
+// batched writes   //
 //////////////////////
 
-switch_status_t radio_gpio_ptt_on(const int radio) {
-   Radio_t *r;
+void radio_gpio_batch_init(GPIOBatch_t *b) {
+   b->count = 0;
+}
 
-   if (radio < 0 || radio >= globals.max_radios) {
-      return SWITCH_STATUS_FALSE;
+// Queue a line change, replacing any earlier change to the same line
+static void gpio_batch_add(GPIOBatch_t *b, const unsigned int offset, const enum gpiod_line_value val) {
+   for (size_t i = 0; i < b->count; i++) {
+      if (b->offsets[i] == offset) {
+         b->values[i] = val;
+         return;
+      }
    }
 
-   r = &Radios(radio);
-
-   if (!r->gpio_ptt) {
-      return SWITCH_STATUS_FALSE;
+   if (b->count >= GPIO_BATCH_MAX) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[gpio] batch full, dropping change to line %u\n", offset);
+      return;
    }
 
-   gpiod_line_request_set_value(
-      r->gpio_ptt,
-      r->pin_ptt,
-      r->pin_ptt_invert ? GPIOD_LINE_VALUE_INACTIVE
-                        : GPIOD_LINE_VALUE_ACTIVE);
-
-   return SWITCH_STATUS_SUCCESS;
+   b->offsets[b->count] = offset;
+   b->values[b->count] = val;
+   b->count++;
 }
 
-switch_status_t radio_gpio_ptt_off(const int radio)
-{
+switch_status_t radio_gpio_batch_ptt(GPIOBatch_t *b, const int radio, const switch_bool_t on) {
    Radio_t *r;
 
-   if (radio < 0 || radio >= globals.max_radios) {
+   if (!radio_exists(radio)) {
       return SWITCH_STATUS_FALSE;
    }
 
@@ -265,20 +468,16 @@ switch_status_t radio_gpio_ptt_off(const int radio)
       return SWITCH_STATUS_FALSE;
    }
 
-   gpiod_line_request_set_value(
-      r->gpio_ptt,
-      r->pin_ptt,
-      r->pin_ptt_invert ? GPIOD_LINE_VALUE_ACTIVE
-                        : GPIOD_LINE_VALUE_INACTIVE);
-
+   gpio_batch_add(b, r->pin_ptt,
+      (on != r->pin_ptt_invert) ? GPIOD_LINE_VALUE_ACTIVE
+                                : GPIOD_LINE_VALUE_INACTIVE);
    return SWITCH_STATUS_SUCCESS;
 }
 
-switch_status_t radio_gpio_power_on(const int radio)
-{
+switch_status_t radio_gpio_batch_power(GPIOBatch_t *b, const int radio, const switch_bool_t on) {
    Radio_t *r;
 
-   if (radio < 0 || radio >= globals.max_radios) {
+   if (!radio_exists(radio)) {
       return SWITCH_STATUS_FALSE;
    }
 
@@ -288,38 +487,79 @@ switch_status_t radio_gpio_power_on(const int radio)
       return SWITCH_STATUS_FALSE;
    }
 
-   gpiod_line_request_set_value(
-      r->gpio_power,
-      r->pin_power,
-      r->pin_power_invert ? GPIOD_LINE_VALUE_INACTIVE
-                          : GPIOD_LINE_VALUE_ACTIVE);
-
+   gpio_batch_add(b, r->pin_power,
+      (on != r->pin_power_invert) ? GPIOD_LINE_VALUE_ACTIVE
+                                  : GPIOD_LINE_VALUE_INACTIVE);
    return SWITCH_STATUS_SUCCESS;
 }
 
-switch_status_t radio_gpio_power_off(const int radio)
-{
-   Radio_t *r;
+// Write every queued change in one ioctl
+switch_status_t radio_gpio_batch_commit(GPIOBatch_t *b) {
+   int rc;
 
-   if (radio < 0 || radio >= globals.max_radios) {
+   if (b->count == 0) {
+      return SWITCH_STATUS_SUCCESS;
+   }
+
+   if (!gpiochip.out) {
+      b->count = 0;
       return SWITCH_STATUS_FALSE;
    }
 
-   r = &Radios(radio);
+   // XXX: Split the batch by chip once we support more than one
+   rc = gpiod_line_request_set_values_subset(gpiochip.out, b->count, b->offsets, b->values);
+   b->count = 0;
 
-   if (!r->gpio_power) {
+   if (rc < 0) {
+      __atomic_add_fetch(&gpio_stats.write_errors, 1, __ATOMIC_RELAXED);
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[gpio] writing lines failed: %s\n", strerror(errno));
       return SWITCH_STATUS_FALSE;
    }
 
-   gpiod_line_request_set_value(
-      r->gpio_power,
-      r->pin_power,
-      r->pin_power_invert ? GPIOD_LINE_VALUE_ACTIVE
-                          : GPIOD_LINE_VALUE_INACTIVE);
-
+   __atomic_add_fetch(&gpio_stats.writes, 1, __ATOMIC_RELAXED);
    return SWITCH_STATUS_SUCCESS;
 }
 
+//////////////////////
+// control helpers   //
+//////////////////////
+
+// Single line changes, for callers that don't need to batch
+static switch_status_t gpio_write_one(const int radio, const switch_bool_t ptt, const switch_bool_t on) {
+   GPIOBatch_t b;
+   switch_status_t rv;
+
+   radio_gpio_batch_init(&b);
+
+   if (ptt) {
+      rv = radio_gpio_batch_ptt(&b, radio, on);
+   } else {
+      rv = radio_gpio_batch_power(&b, radio, on);
+   }
+
+   if (rv != SWITCH_STATUS_SUCCESS) {
+      return rv;
+   }
+
+   return radio_gpio_batch_commit(&b);
+}
+
+switch_status_t radio_gpio_ptt_on(const int radio) {
+   return gpio_write_one(radio, true, true);
+}
+
+switch_status_t radio_gpio_ptt_off(const int radio) {
+   return gpio_write_one(radio, true, false);
+}
+
+switch_status_t radio_gpio_power_on(const int radio) {
+   return gpio_write_one(radio, false, true);
+}
+
+switch_status_t radio_gpio_power_off(const int radio) {
+   return gpio_write_one(radio, false, false);
+}
+
 //////////////////////
 // squelch read     //
 //////////////////////
@@ -328,7 +568,7 @@ int radio_gpio_read_squelch(const int radio)
 {
    Radio_t *r;
 
-   if (radio < 0 || radio >= globals.max_radios) {
+   if (!radio_exists(radio)) {
       return -1;
    }
 
@@ -344,6 +584,7 @@ int radio_gpio_read_squelch(const int radio)
          r->pin_squelch);
 
    if (v < 0) {
+      __atomic_add_fetch(&gpio_stats.read_errors, 1, __ATOMIC_RELAXED);
       return -1;
    }
 
@@ -353,3 +594,73 @@ int radio_gpio_read_squelch(const int radio)
 
    return v == GPIOD_LINE_VALUE_ACTIVE;
 }
+
+//////////////////////
+// squelch events   //
+//////////////////////
+
+// Returns the fd to wait on for squelch edges, or -1 if no squelch lines are requested
+int radio_gpio_event_fd(void)
+{
+   if (!gpiochip.req) {
+      return -1;
+   }
+
+   return gpiod_line_request_get_fd(gpiochip.req);
+}
+
+// Hand an edge to every radio listening on that line
+static void gpio_dispatch_edge(struct gpiod_edge_event *ev) {
+   unsigned int offset = gpiod_edge_event_get_line_offset(ev);
+   int rising = (gpiod_edge_event_get_event_type(ev) == GPIOD_EDGE_EVENT_RISING_EDGE);
+   uint64_t ts = gpiod_edge_event_get_timestamp_ns(ev);
+
+   for (int radio = 0; radio < globals.max_radios; radio++) {
+      if (!radio_exists(radio)) {
+         continue;
+      }
+
+      Radio_t *r = &Radios(radio);
+
+      if (r->gpio_squelch == NULL || r->pin_squelch != offset) {
+         continue;
+      }
+
+      radio_squelch_edge(radio, (r->squelch_invert ? !rising : rising), ts);
+   }
+}
+
+// Drain pending edge events from the chip and feed them, with the
+// kernel's timestamps, to the debouncer of each radio on that line.
+// Returns the number of edges read, or -1 if nothing could be read.
+int radio_gpio_events(void)
+{
+   int n, total = 0;
+
+   if (!gpiochip.req || !squelch_events) {
+      return -1;
+   }
+
+   do {
+      if ((n = gpiod_line_request_read_edge_events(gpiochip.req, squelch_events, SQUELCH_EVENT_BUF)) <= 0) {
+         if (n < 0) {
+            __atomic_add_fetch(&gpio_stats.event_errors, 1, __ATOMIC_RELAXED);
+         }
+         break;
+      }
+
+      __atomic_add_fetch(&gpio_stats.edges, n, __ATOMIC_RELAXED);
+
+      for (int i = 0; i < n; i++) {
+         gpio_dispatch_edge(gpiod_edge_event_buffer_get_event(squelch_events, i));
+      }
+      total += n;
+   // read_edge_events blocks when the queue is empty, so only go around again if more are waiting
+   } while (n == SQUELCH_EVENT_BUF && gpiod_line_request_wait_edge_events(gpiochip.req, 0) > 0);
+
+   return (total > 0 ? total : -1);
+}
+
+const GPIOStats_t *radio_gpio_stats(void) {
+   return &gpio_stats;
+}
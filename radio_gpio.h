@@ -6,14 +6,29 @@ struct GPIO_pin {
 };
 typedef struct GPIO_pin GPIOpin;
 
+// Pending output line changes, written together by radio_gpio_batch_commit()
+#define	GPIO_BATCH_MAX	64
+struct GPIOBatch {
+    size_t count;
+    unsigned int offsets[GPIO_BATCH_MAX];
+    enum gpiod_line_value values[GPIO_BATCH_MAX];
+};
+typedef struct GPIOBatch GPIOBatch_t;
+
 /////////////////
 /// prototypes //
 /////////////////
 // Setup a GPIO controller chip
 extern int radio_gpiochip_init(const char *chipname);
 
-// Setup the needed libgpiod data for the radio line and set initial state (power on if enabled)
-extern int radio_gpio_init(const int radio);
+// Request the lines of every radio (one output request, one squelch input request), outputs start off
+extern int radio_gpio_init(void);
+
+// Catch the requests up with radios that were added, removed or changed pins
+extern int radio_gpio_rebuild(void);
+
+// Do two radios' settings need different lines requested?
+extern switch_bool_t radio_gpio_differs(const Radio_t *a, const Radio_t *b);
 
 // Shut down gpio and free all resources (for unload or reload)
 extern switch_status_t radio_gpio_fini(void);
@@ -21,6 +36,12 @@ extern switch_status_t radio_gpio_fini(void);
 // find an already initialized GPIO controller chip by name
 struct gpiod_chip *radio_find_gpiochip(const char *name);
 
+// Batched output changes: queue up any number, then write them in one go
+extern void radio_gpio_batch_init(GPIOBatch_t *b);
+extern switch_status_t radio_gpio_batch_ptt(GPIOBatch_t *b, const int radio, const switch_bool_t on);
+extern switch_status_t radio_gpio_batch_power(GPIOBatch_t *b, const int radio, const switch_bool_t on);
+extern switch_status_t radio_gpio_batch_commit(GPIOBatch_t *b);
+
 // PTT on
 extern switch_status_t radio_gpio_ptt_on(const int radio);
 
@@ -35,4 +56,20 @@ extern switch_status_t radio_gpio_power_off(const int radio);
 
 // Read squelch input
 extern int radio_gpio_read_squelch(const int radio);
+
+// Squelch edge events for all radios (for the runtime thread)
+extern int radio_gpio_event_fd(void);
+extern int radio_gpio_events(void);
+
+// Line traffic and errors, since load
+struct GPIOStats {
+   uint64_t	writes;			// batches written
+   uint64_t	write_errors;
+   uint64_t	read_errors;		// squelch reads
+   uint64_t	edges;			// squelch edge events read
+   uint64_t	event_errors;		// reading edge events failed
+};
+typedef struct GPIOStats GPIOStats_t;
+
+extern const GPIOStats_t *radio_gpio_stats(void);
 #endif	// !defined(RADIO_GPIO_H)
@@ -174,33 +174,33 @@ switch_status_t radio_hamlib_init_radio(const int radio) {
     Radio_t *r = NULL;
     int rc = 0;
 
-    if (radio < 0 || radio > globals.max_radios) {
+    if (!radio_exists(radio)) {
        err_invalid_radio(radio);
        return SWITCH_STATUS_FALSE;
     }
     r = &Radios(radio);
 
     // Interface is already up, don't change it
-    if (r->rig) {
+    if (r->cold->rig) {
        return SWITCH_STATUS_SUCCESS;
     }    
 
-    if ((r->rig = rig_init(r->rig_model)) == NULL) {
-       switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "radio%d connecting to hamlib failed (model: %d)\n", radio, r->rig_model);
+    if ((r->cold->rig = rig_init(r->cold->rig_model)) == NULL) {
+       switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "radio%d connecting to hamlib failed (model: %d)\n", radio, r->cold->rig_model);
        return SWITCH_STATUS_FALSE;
     }
 
     // XXX: We need to parse hamlib configuration URL
-    r->rig_port.type.rig = RIG_PORT_SERIAL;
-    r->rig_port.parm.serial.rate = 9600;
-    r->rig_port.parm.serial.data_bits = 8;
-    r->rig_port.parm.serial.stop_bits = 1;
-    r->rig_port.parm.serial.parity = RIG_PARITY_NONE;
-    r->rig_port.parm.serial.handshake = RIG_HANDSHAKE_NONE;
-    strncpy(r->rig_port.pathname, r->rig_path, HAMLIB_FILPATHLEN);
-    strncpy(r->rig->state.rigport.pathname, r->rig_path, HAMLIB_FILPATHLEN);
-
-    if ((rc = rig_open(r->rig)) != RIG_OK) {
+    r->cold->rig_port.type.rig = RIG_PORT_SERIAL;
+    r->cold->rig_port.parm.serial.rate = 9600;
+    r->cold->rig_port.parm.serial.data_bits = 8;
+    r->cold->rig_port.parm.serial.stop_bits = 1;
+    r->cold->rig_port.parm.serial.parity = RIG_PARITY_NONE;
+    r->cold->rig_port.parm.serial.handshake = RIG_HANDSHAKE_NONE;
+    strncpy(r->cold->rig_port.pathname, r->cold->rig_path, HAMLIB_FILPATHLEN);
+    strncpy(r->cold->rig->state.rigport.pathname, r->cold->rig_path, HAMLIB_FILPATHLEN);
+
+    if ((rc = rig_open(r->cold->rig)) != RIG_OK) {
        switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "radio%d connecting to hamlib returned %s\n", radio, rigerror(rc));
        return SWITCH_STATUS_FALSE;
     }
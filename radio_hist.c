@@ -0,0 +1,94 @@
+/*
+ * Lock-free log-linear histograms
+ *
+ * Used for latency (squelch -> RX, PTT request -> line keyed) and anything
+ * else where we want p50/p99/max without keeping every sample around.
+ */
+#include "mod_hamradio.h"
+
+int radio_hist_bucket(const uint64_t val) {
+   int exp, idx;
+
+   // small values get a bucket each
+   if (val < HIST_SUB) {
+      return (int)val;
+   }
+
+   exp = 63 - __builtin_clzll(val);
+   idx = ((exp - HIST_SUB_BITS + 1) * HIST_SUB) + (int)((val >> (exp - HIST_SUB_BITS)) & (HIST_SUB - 1));
+
+   return (idx < HIST_BUCKETS ? idx : HIST_BUCKETS - 1);
+}
+
+// Largest value that lands in bucket idx
+uint64_t radio_hist_bucket_max(const int idx) {
+   int exp;
+
+   if (idx < HIST_SUB) {
+      return (uint64_t)idx;
+   }
+
+   if (idx >= HIST_BUCKETS - 1) {
+      return UINT64_MAX;
+   }
+
+   exp = (idx / HIST_SUB) + HIST_SUB_BITS - 1;
+   return ((((uint64_t)HIST_SUB + (idx % HIST_SUB) + 1)) << (exp - HIST_SUB_BITS)) - 1;
+}
+
+void radio_hist_add(RadioHist_t *h, const uint64_t val) {
+   uint64_t max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+
+   __atomic_fetch_add(&h->buckets[radio_hist_bucket(val)], 1, __ATOMIC_RELAXED);
+   __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+   __atomic_fetch_add(&h->sum, val, __ATOMIC_RELAXED);
+
+   while (val > max &&
+          !__atomic_compare_exchange_n(&h->max, &max, val, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      ;
+   }
+}
+
+// Racy against writers, but only ever loses a sample or two
+void radio_hist_reset(RadioHist_t *h) {
+   for (int i = 0; i < HIST_BUCKETS; i++) {
+      __atomic_store_n(&h->buckets[i], 0, __ATOMIC_RELAXED);
+   }
+
+   __atomic_store_n(&h->count, 0, __ATOMIC_RELAXED);
+   __atomic_store_n(&h->sum, 0, __ATOMIC_RELAXED);
+   __atomic_store_n(&h->max, 0, __ATOMIC_RELAXED);
+}
+
+uint64_t radio_hist_percentile(RadioHist_t *h, const double pct) {
+   uint64_t total = 0, want, seen = 0;
+   uint64_t max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+   uint32_t snap[HIST_BUCKETS];
+
+   // count from the buckets themselves so the walk is self-consistent
+   for (int i = 0; i < HIST_BUCKETS; i++) {
+      snap[i] = __atomic_load_n(&h->buckets[i], __ATOMIC_RELAXED);
+      total += snap[i];
+   }
+
+   if (total == 0) {
+      return 0;
+   }
+
+   want = (uint64_t)((pct / 100.0) * total + 0.5);
+
+   if (want < 1) {
+      want = 1;
+   }
+
+   for (int i = 0; i < HIST_BUCKETS; i++) {
+      seen += snap[i];
+
+      if (seen >= want) {
+         uint64_t v = radio_hist_bucket_max(i);
+         return (v < max ? v : max);
+      }
+   }
+
+   return max;
+}
@@ -0,0 +1,31 @@
+#if	!defined(RADIO_HIST_H)
+#define	RADIO_HIST_H
+#include <stdint.h>
+
+//
+// Log-linear histograms (8 sub-buckets per power of two, ~12% resolution)
+//
+// Updated with relaxed atomics so they can be sampled from any thread on
+// hot paths without locking. Units are up to the caller (usually us or ms).
+//
+#define	HIST_SUB_BITS	3
+#define	HIST_SUB	(1 << HIST_SUB_BITS)
+#define	HIST_BUCKETS	(HIST_SUB * 40)		// covers values up to 2^41
+
+struct RadioHist {
+   uint32_t	buckets[HIST_BUCKETS];
+   uint64_t	count;
+   uint64_t	sum;
+   uint64_t	max;
+};
+typedef struct RadioHist RadioHist_t;
+
+extern void radio_hist_add(RadioHist_t *h, const uint64_t val);
+extern void radio_hist_reset(RadioHist_t *h);
+// Value at or below which pct (0-100) of the samples fall (bucket upper bound)
+extern uint64_t radio_hist_percentile(RadioHist_t *h, const double pct);
+// Bucket helpers, for exporting the whole histogram
+extern int radio_hist_bucket(const uint64_t val);
+extern uint64_t radio_hist_bucket_max(const int idx);
+
+#endif	// !defined(RADIO_HIST_H)
@@ -0,0 +1,197 @@
+/*
+ * Prometheus text format metrics
+ */
+#include <stdarg.h>
+#include "mod_hamradio.h"
+
+// Latency (us) and session length (ms) buckets we export, out of the full log-linear
+// histograms. Each is rounded up to the edge of the histogram bucket it falls in
+static const uint64_t latency_le_us[] = { 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000 };
+static const uint64_t duration_le_ms[] = { 1000, 2000, 5000, 10000, 30000, 60000, 120000, 180000, 300000, 600000 };
+
+#define	ARRAY_LEN(a)	(sizeof(a) / sizeof((a)[0]))
+
+static struct {
+   char		buf[RADIO_METRICS_BUF];
+   size_t	len;
+   switch_bool_t truncated;
+   switch_mutex_t *mutex;		// one scrape at a time owns buf
+} metrics;
+
+static void m_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+static void m_printf(const char *fmt, ...) {
+   va_list ap;
+   int n;
+
+   if (metrics.truncated) {
+      return;
+   }
+
+   va_start(ap, fmt);
+   n = vsnprintf(metrics.buf + metrics.len, sizeof(metrics.buf) - metrics.len, fmt, ap);
+   va_end(ap);
+
+   if (n < 0 || (size_t)n >= sizeof(metrics.buf) - metrics.len) {
+      metrics.buf[metrics.len] = '\0';
+      metrics.truncated = true;
+      return;
+   }
+
+   metrics.len += n;
+}
+
+static void m_family(const char *name, const char *type, const char *help) {
+   m_printf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+// scale turns the histogram's unit into seconds. Every le is a bucket edge, and
+// the counts all come from one pass over the buckets so they add up
+static void m_hist(const char *name, const char *labels, RadioHist_t *h, const uint64_t *le, const size_t nle, const double scale) {
+   uint64_t n = 0;
+   int idx = 0, bucket, last = -1;
+
+   for (size_t i = 0; i < nle; i++) {
+      // Nominal bounds close together can land in the same bucket
+      if ((bucket = radio_hist_bucket(le[i])) <= last) {
+         continue;
+      }
+
+      for (; idx <= bucket; idx++) {
+         n += __atomic_load_n(&h->buckets[idx], __ATOMIC_RELAXED);
+      }
+      last = bucket;
+
+      m_printf("%s_bucket{%s,le=\"%.15g\"} %" PRIu64 "\n", name, labels, radio_hist_bucket_max(last) * scale, n);
+   }
+
+   for (; idx < HIST_BUCKETS; idx++) {
+      n += __atomic_load_n(&h->buckets[idx], __ATOMIC_RELAXED);
+   }
+
+   m_printf("%s_bucket{%s,le=\"+Inf\"} %" PRIu64 "\n", name, labels, n);
+   m_printf("%s_sum{%s} %.15g\n", name, labels, (double)__atomic_load_n(&h->sum, __ATOMIC_RELAXED) * scale);
+   m_printf("%s_count{%s} %" PRIu64 "\n", name, labels, n);
+}
+
+void radio_metrics_render(switch_stream_handle_t *stream) {
+   static int radios[RADIO_TABLE_MAX];
+   static RadioSnapshot_t snaps[RADIO_TABLE_MAX];
+   static Radio_t *rp[RADIO_TABLE_MAX];
+   static time_t duty_left[RADIO_TABLE_MAX];
+   const GPIOStats_t *gs = radio_gpio_stats();
+   int n = 0, rcu;
+
+   if (!metrics.mutex) {
+      switch_mutex_lock(globals.mutex);
+      if (!metrics.mutex) {
+         switch_mutex_init(&metrics.mutex, SWITCH_MUTEX_UNNESTED, globals.pool);
+      }
+      switch_mutex_unlock(globals.mutex);
+   }
+
+   switch_mutex_lock(metrics.mutex);
+   metrics.len = 0;
+   metrics.truncated = false;
+   metrics.buf[0] = '\0';
+
+   rcu = radio_rcu_read_lock();
+
+   // One consistent snapshot per radio, everything below renders from these. The
+   // Radio_t is kept too: a radio removed meanwhile stays valid until we leave the
+   // read section, where looking it up again could find the removed-radio sentinel
+   for (int radio = 0; radio < globals.max_radios && n < RADIO_TABLE_MAX; radio++) {
+      if (radio_snapshot(radio, &snaps[n]) == SWITCH_STATUS_SUCCESS) {
+         rp[n] = &Radios(radio);
+         duty_left[n] = radio_duty_remaining(radio);
+         radios[n++] = radio;
+      }
+   }
+
+   m_family("hamradio_radio_state", "gauge", "Radio state (0 off, 1 idle, 2 rx, 3 tx, 4 tx_data)");
+   for (int i = 0; i < n; i++) {
+      m_printf("hamradio_radio_state{radio=\"%d\"} %d\n", radios[i], snaps[i].status);
+   }
+
+   m_family("hamradio_radio_enabled", "gauge", "Radio is enabled");
+   for (int i = 0; i < n; i++) {
+      m_printf("hamradio_radio_enabled{radio=\"%d\"} %d\n", radios[i], (snaps[i].enabled ? 1 : 0));
+   }
+
+   m_family("hamradio_radio_penalty_seconds", "gauge", "TOT penalty left before TX is allowed again");
+   for (int i = 0; i < n; i++) {
+      m_printf("hamradio_radio_penalty_seconds{radio=\"%d\"} %ld\n", radios[i], (long)radio_snapshot_penalty(&snaps[i]));
+   }
+
+   m_family("hamradio_radio_duty_budget_seconds", "gauge", "TX time left under the duty cycle limit (radios with one)");
+   for (int i = 0; i < n; i++) {
+      if (duty_left[i] >= 0) {
+         m_printf("hamradio_radio_duty_budget_seconds{radio=\"%d\"} %ld\n", radios[i], (long)duty_left[i]);
+      }
+   }
+
+   m_family("hamradio_radio_last_rx_timestamp_seconds", "gauge", "End of the last reception");
+   for (int i = 0; i < n; i++) {
+      m_printf("hamradio_radio_last_rx_timestamp_seconds{radio=\"%d\"} %ld\n", radios[i], (long)snaps[i].last_rx);
+   }
+
+   m_family("hamradio_radio_last_tx_timestamp_seconds", "gauge", "End of the last transmission");
+   for (int i = 0; i < n; i++) {
+      m_printf("hamradio_radio_last_tx_timestamp_seconds{radio=\"%d\"} %ld\n", radios[i], (long)snaps[i].last_tx);
+   }
+
+#define	COUNTER(metric, help, field, scale) \
+   m_family(metric, "counter", help); \
+   for (int i = 0; i < n; i++) { \
+      RadioCounters_t *c = rp[i]->cold->stats.ctr; \
+      m_printf(metric "{radio=\"%d\"} %.15g\n", radios[i], (double)__atomic_load_n(&c->field, __ATOMIC_RELAXED) * (scale)); \
+   }
+
+   COUNTER("hamradio_radio_rx_seconds_total", "Time spent receiving", rx_ms_total, 0.001)
+   COUNTER("hamradio_radio_tx_seconds_total", "Time spent transmitting", tx_ms_total, 0.001)
+   COUNTER("hamradio_radio_rx_sessions_total", "Receptions", rx_sessions, 1)
+   COUNTER("hamradio_radio_tx_sessions_total", "Transmissions", tx_sessions, 1)
+   COUNTER("hamradio_radio_tot_trips_total", "Transmissions cut short by the TOT", tot_trips, 1)
+   COUNTER("hamradio_radio_ptt_blocked_total", "PTT requests refused during a TOT penalty", ptt_blocked, 1)
+   COUNTER("hamradio_radio_squelch_flaps_total", "Squelch edges rejected by the debouncer", squelch_flaps, 1)
+#undef	COUNTER
+
+   m_family("hamradio_radio_latency_seconds", "histogram", "Squelch edge to RX, and PTT request to line keyed");
+   for (int i = 0; i < n; i++) {
+      RadioCold_t *cold = rp[i]->cold;
+      char labels[64];
+
+      snprintf(labels, sizeof(labels), "radio=\"%d\",path=\"squelch\"", radios[i]);
+      m_hist("hamradio_radio_latency_seconds", labels, &cold->lat_squelch, latency_le_us, ARRAY_LEN(latency_le_us), 0.000001);
+      snprintf(labels, sizeof(labels), "radio=\"%d\",path=\"ptt\"", radios[i]);
+      m_hist("hamradio_radio_latency_seconds", labels, &cold->lat_ptt, latency_le_us, ARRAY_LEN(latency_le_us), 0.000001);
+   }
+
+   m_family("hamradio_radio_session_seconds", "histogram", "Length of each reception and transmission");
+   for (int i = 0; i < n; i++) {
+      RadioStats_t *st = &rp[i]->cold->stats;
+      char labels[64];
+
+      snprintf(labels, sizeof(labels), "radio=\"%d\",dir=\"rx\"", radios[i]);
+      m_hist("hamradio_radio_session_seconds", labels, &st->rx_ms, duration_le_ms, ARRAY_LEN(duration_le_ms), 0.001);
+      snprintf(labels, sizeof(labels), "radio=\"%d\",dir=\"tx\"", radios[i]);
+      m_hist("hamradio_radio_session_seconds", labels, &st->tx_ms, duration_le_ms, ARRAY_LEN(duration_le_ms), 0.001);
+   }
+
+   radio_rcu_read_unlock(rcu);
+
+   m_family("hamradio_gpio_writes_total", "counter", "GPIO output batches written");
+   m_printf("hamradio_gpio_writes_total %" PRIu64 "\n", __atomic_load_n(&gs->writes, __ATOMIC_RELAXED));
+   m_family("hamradio_gpio_errors_total", "counter", "GPIO operations that failed");
+   m_printf("hamradio_gpio_errors_total{op=\"write\"} %" PRIu64 "\n", __atomic_load_n(&gs->write_errors, __ATOMIC_RELAXED));
+   m_printf("hamradio_gpio_errors_total{op=\"read\"} %" PRIu64 "\n", __atomic_load_n(&gs->read_errors, __ATOMIC_RELAXED));
+   m_printf("hamradio_gpio_errors_total{op=\"edge_events\"} %" PRIu64 "\n", __atomic_load_n(&gs->event_errors, __ATOMIC_RELAXED));
+   m_family("hamradio_gpio_edges_total", "counter", "Squelch edge events read");
+   m_printf("hamradio_gpio_edges_total %" PRIu64 "\n", __atomic_load_n(&gs->edges, __ATOMIC_RELAXED));
+
+   if (metrics.truncated) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "[metrics] output truncated at %lu bytes\n", (unsigned long)metrics.len);
+   }
+
+   stream->write_function(stream, "%s", metrics.buf);
+   switch_mutex_unlock(metrics.mutex);
+}
@@ -0,0 +1,15 @@
+#if	!defined(RADIO_METRICS_H)
+#define	RADIO_METRICS_H
+
+//
+// hamradio metrics: Prometheus text exposition
+//
+// Everything is rendered into one preallocated buffer and written to the
+// API stream in a single call, so a scraper polling every second costs a
+// few snapshots and some formatting, nothing more.
+//
+#define	RADIO_METRICS_BUF	(256 * 1024)
+
+extern void radio_metrics_render(switch_stream_handle_t *stream);
+
+#endif	// !defined(RADIO_METRICS_H)
@@ -0,0 +1,121 @@
+/*
+ * hamradio::state custom events
+ *
+ * radio_set_state() only notes what changed and arms the radio's window
+ * timer. The event itself is built when the window closes, on the runtime
+ * thread, by duplicating a template made once at startup and filling in
+ * the per-radio headers.
+ */
+#include "mod_hamradio.h"
+
+static struct {
+   switch_event_t *template;		// subclass + the headers that never change
+   int		running;
+} notify;
+
+static void notify_fire(const int radio, void *data) {
+   RadioNotify_t *n;
+   RadioSnapshot_t snap;
+   switch_event_t *evt = NULL;
+
+   if (!notify.running || !radio_exists(radio)) {
+      return;
+   }
+
+   n = &Radios(radio).cold->notify;
+
+   if (n->changes == 0 || radio_snapshot(radio, &snap) != SWITCH_STATUS_SUCCESS) {
+      return;
+   }
+
+   if (switch_event_dup(&evt, notify.template) != SWITCH_STATUS_SUCCESS) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[notify] can't build %s event for radio%d\n", RADIO_NOTIFY_SUBCLASS, radio);
+      n->changes = 0;
+      return;
+   }
+
+   switch_event_add_header(evt, SWITCH_STACK_BOTTOM, "Radio", "%d", radio);
+   switch_event_add_header_string(evt, SWITCH_STACK_BOTTOM, "Old-State", radio_status_name(n->from));
+   switch_event_add_header_string(evt, SWITCH_STACK_BOTTOM, "New-State", radio_status_name(n->to));
+   switch_event_add_header_string(evt, SWITCH_STACK_BOTTOM, "Enabled", (snap.enabled ? "true" : "false"));
+   switch_event_add_header(evt, SWITCH_STACK_BOTTOM, "Changes", "%u", n->changes);
+   switch_event_add_header(evt, SWITCH_STACK_BOTTOM, "Window-Ms", "%" PRIu64, radio_now_ms() - n->first_ms);
+   switch_event_add_header(evt, SWITCH_STACK_BOTTOM, "Last-RX", "%ld", (long)snap.last_rx);
+   switch_event_add_header(evt, SWITCH_STACK_BOTTOM, "Last-TX", "%ld", (long)snap.last_tx);
+   switch_event_add_header(evt, SWITCH_STACK_BOTTOM, "Last-ID", "%ld", (long)snap.last_id);
+   switch_event_add_header(evt, SWITCH_STACK_BOTTOM, "Total-RX", "%ld", (long)snap.total_rx);
+   switch_event_add_header(evt, SWITCH_STACK_BOTTOM, "Total-TX", "%ld", (long)snap.total_tx);
+   switch_event_add_header(evt, SWITCH_STACK_BOTTOM, "Penalty-Remaining", "%ld", (long)radio_snapshot_penalty(&snap));
+
+   n->changes = 0;
+   switch_event_fire(&evt);
+}
+
+void radio_notify_state(const int radio, const int old, const int new) {
+   RadioNotify_t *n;
+   int64_t window;
+
+   if (!notify.running || !radio_exists(radio)) {
+      return;
+   }
+
+   n = &Radios(radio).cold->notify;
+
+   if (n->timer.cb == NULL) {
+      radio_timer_setup(&n->timer, "notify", radio, notify_fire, NULL);
+   }
+
+   // First change in this window remembers where we started from
+   if (n->changes == 0) {
+      n->from = old;
+      n->first_ms = radio_now_ms();
+   }
+
+   n->to = new;
+   n->changes++;
+
+   // state_event_window: ms to coalesce changes over
+   if ((window = dconf_msecs(CFGH_STATE_EVENT_WINDOW)) == 0) {
+      notify_fire(radio, NULL);
+   } else if (!radio_timer_armed(&n->timer)) {
+      radio_timer_arm(&n->timer, window);
+   }
+}
+
+switch_status_t radio_notify_init(void) {
+   if (notify.running) {
+      return SWITCH_STATUS_SUCCESS;
+   }
+
+   if (switch_event_reserve_subclass(RADIO_NOTIFY_SUBCLASS) != SWITCH_STATUS_SUCCESS) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[notify] couldn't register event subclass %s\n", RADIO_NOTIFY_SUBCLASS);
+      return SWITCH_STATUS_FALSE;
+   }
+
+   if (switch_event_create_subclass(&notify.template, SWITCH_EVENT_CUSTOM, RADIO_NOTIFY_SUBCLASS) != SWITCH_STATUS_SUCCESS) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[notify] couldn't create %s event template\n", RADIO_NOTIFY_SUBCLASS);
+      switch_event_free_subclass(RADIO_NOTIFY_SUBCLASS);
+      return SWITCH_STATUS_FALSE;
+   }
+
+   switch_event_add_header_string(notify.template, SWITCH_STACK_BOTTOM, "Module", globals.modname);
+   notify.running = 1;
+   return SWITCH_STATUS_SUCCESS;
+}
+
+void radio_notify_fini(void) {
+   if (!notify.running) {
+      return;
+   }
+
+   notify.running = 0;
+
+   for (int radio = 0; radio < globals.max_radios; radio++) {
+      if (radio_exists(radio)) {
+         radio_timer_cancel(&Radios(radio).cold->notify.timer);
+      }
+   }
+
+   switch_event_destroy(&notify.template);
+   switch_event_free_subclass(RADIO_NOTIFY_SUBCLASS);
+}
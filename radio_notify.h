@@ -0,0 +1,31 @@
+#if	!defined(RADIO_NOTIFY_H)
+#define	RADIO_NOTIFY_H
+
+//
+// hamradio::state custom events
+//
+// Every state change is pushed to event subscribers (ESL, dashboards) as a
+// CUSTOM hamradio::state event carrying the radio, the old and new state,
+// timestamps and counters. Changes within state_event_window ms (default
+// 250, 0 = send each one) of the first are coalesced into one event, so a
+// flapping squelch costs one event per window rather than one per edge.
+//
+#define	RADIO_NOTIFY_SUBCLASS	"hamradio::state"
+
+// Per-radio coalescing state (lives in RadioCold_t)
+struct RadioNotify {
+   RadioTimer_t	timer;			// end of the coalescing window
+   int		from;			// RadioStatus_t before the first change in this window
+   int		to;			// ... and the latest one
+   uint32_t	changes;		// changes folded into this window
+   uint64_t	first_ms;		// when the first one happened (radio_now_ms)
+};
+typedef struct RadioNotify RadioNotify_t;
+
+extern switch_status_t radio_notify_init(void);
+extern void radio_notify_fini(void);
+
+// A radio went from old to new (radio_set_state)
+extern void radio_notify_state(const int radio, const int old, const int new);
+
+#endif	// !defined(RADIO_NOTIFY_H)
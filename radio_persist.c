@@ -0,0 +1,135 @@
+/*
+ * mmap'd persistent counters
+ */
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mod_hamradio.h"
+
+static struct {
+   RadioPersistHeader_t *hdr;		// start of the mapping
+   RadioCounters_t *slots;		// hdr->slots of them, right after the header
+   size_t	size;
+   int		fd;
+} persist = { .fd = -1 };
+
+#define	PERSIST_SIZE	(sizeof(RadioPersistHeader_t) + (sizeof(RadioCounters_t) * RADIO_TABLE_MAX))
+
+static switch_bool_t persist_valid(const RadioPersistHeader_t *hdr, const off_t size) {
+   return (size == (off_t)PERSIST_SIZE &&
+           hdr->magic == RADIO_PERSIST_MAGIC &&
+           hdr->version == RADIO_PERSIST_VERSION &&
+           hdr->header_size == sizeof(RadioPersistHeader_t) &&
+           hdr->slot_size == sizeof(RadioCounters_t) &&
+           hdr->slots == RADIO_TABLE_MAX);
+}
+
+switch_status_t radio_persist_init(void) {
+   char path[PATH_MAX];
+   CfgGeneral_t *cfg;
+   const char *file;
+   struct stat st;
+   void *map;
+   switch_bool_t fresh = false;
+
+   if (persist.hdr) {
+      return SWITCH_STATUS_SUCCESS;
+   }
+
+   cfg = dconf_hold();
+   file = dconf_str(cfg, "counters_file", RADIO_PERSIST_FILE);
+
+   if (file[0] == '/') {
+      snprintf(path, sizeof(path), "%s", file);
+   } else {
+      snprintf(path, sizeof(path), "%s%s%s", SWITCH_GLOBAL_dirs.db_dir, SWITCH_PATH_SEPARATOR, file);
+   }
+
+   dconf_release(cfg);
+
+   if ((persist.fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0640)) < 0) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[persist] can't open %s: %s, counters won't survive a restart\n", path, strerror(errno));
+      return SWITCH_STATUS_FALSE;
+   }
+
+   if (fstat(persist.fd, &st) < 0) {
+      st.st_size = 0;
+   }
+
+   // Anything that isn't exactly what we'd write ourselves is moved aside, not trusted
+   if (st.st_size != 0 && st.st_size != (off_t)PERSIST_SIZE) {
+      char bad[PATH_MAX + 8];
+
+      snprintf(bad, sizeof(bad), "%s.bad", path);
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "[persist] %s is the wrong size (%ld bytes), moving it to %s\n", path, (long)st.st_size, bad);
+      rename(path, bad);
+      close(persist.fd);
+
+      if ((persist.fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0640)) < 0) {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[persist] can't create %s: %s\n", path, strerror(errno));
+         return SWITCH_STATUS_FALSE;
+      }
+      st.st_size = 0;
+   }
+
+   if (st.st_size == 0) {
+      if (ftruncate(persist.fd, PERSIST_SIZE) < 0) {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[persist] can't size %s: %s\n", path, strerror(errno));
+         close(persist.fd);
+         persist.fd = -1;
+         return SWITCH_STATUS_FALSE;
+      }
+      fresh = true;
+   }
+
+   if ((map = mmap(NULL, PERSIST_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, persist.fd, 0)) == MAP_FAILED) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[persist] can't map %s: %s\n", path, strerror(errno));
+      close(persist.fd);
+      persist.fd = -1;
+      return SWITCH_STATUS_FALSE;
+   }
+
+   persist.hdr = map;
+   persist.size = PERSIST_SIZE;
+   persist.slots = (RadioCounters_t *)((char *)map + sizeof(RadioPersistHeader_t));
+
+   if (!fresh && !persist_valid(persist.hdr, (off_t)PERSIST_SIZE)) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "[persist] %s is from another version (v%u), starting the counters over\n", path, persist.hdr->version);
+      fresh = true;
+   }
+
+   if (fresh) {
+      memset(map, 0, PERSIST_SIZE);
+      persist.hdr->magic = RADIO_PERSIST_MAGIC;
+      persist.hdr->version = RADIO_PERSIST_VERSION;
+      persist.hdr->header_size = sizeof(RadioPersistHeader_t);
+      persist.hdr->slot_size = sizeof(RadioCounters_t);
+      persist.hdr->slots = RADIO_TABLE_MAX;
+      persist.hdr->created = time(NULL);
+      msync(map, PERSIST_SIZE, MS_ASYNC);
+   }
+
+   switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "[persist] counters in %s%s\n", path, (fresh ? " (new)" : ""));
+   return SWITCH_STATUS_SUCCESS;
+}
+
+// Only once every radio pointing into the mapping is gone
+void radio_persist_fini(void) {
+   if (!persist.hdr) {
+      return;
+   }
+
+   msync(persist.hdr, persist.size, MS_SYNC);
+   munmap(persist.hdr, persist.size);
+   close(persist.fd);
+   persist.hdr = NULL;
+   persist.slots = NULL;
+   persist.fd = -1;
+}
+
+RadioCounters_t *radio_persist_slot(const int radio) {
+   if (!persist.hdr || radio < 0 || radio >= RADIO_TABLE_MAX) {
+      return NULL;
+   }
+
+   return &persist.slots[radio];
+}
@@ -0,0 +1,34 @@
+#if	!defined(RADIO_PERSIST_H)
+#define	RADIO_PERSIST_H
+
+//
+// Counters that survive reloads and restarts
+//
+// Every radio's RadioCounters_t lives in a small file (counters_file in
+// [general], default hamradio.counters in the FreeSWITCH db dir) that is
+// mmap'd shared, so the state machine bumps them in place with no syscalls
+// and the kernel writes them back. The header is checked at load; a file
+// from another version (or a damaged one) is set aside and started over.
+//
+#define	RADIO_PERSIST_MAGIC	0x4348414dU	// "MAHC"
+#define	RADIO_PERSIST_VERSION	1
+#define	RADIO_PERSIST_FILE	"hamradio.counters"
+
+struct RadioPersistHeader {
+   uint32_t	magic;
+   uint32_t	version;
+   uint32_t	header_size;		// sizeof(RadioPersistHeader_t)
+   uint32_t	slot_size;		// sizeof(RadioCounters_t)
+   uint32_t	slots;			// RADIO_TABLE_MAX when it was made
+   uint32_t	reserved;
+   int64_t	created;		// time_t
+} __attribute__((aligned(64)));
+typedef struct RadioPersistHeader RadioPersistHeader_t;
+
+extern switch_status_t radio_persist_init(void);
+extern void radio_persist_fini(void);
+
+// Radio's counters in the file, NULL if there's no file
+extern RadioCounters_t *radio_persist_slot(const int radio);
+
+#endif	// !defined(RADIO_PERSIST_H)
@@ -0,0 +1,179 @@
+/*
+ * Real-time scheduling, CPU pinning and memory locking
+ *
+ * A busy FreeSWITCH (transcoding, big conferences) will happily keep the
+ * runtime thread off the CPU long enough to unkey late. These knobs let the
+ * operator give it a real-time priority and a core of its own.
+ */
+#if	!defined(_GNU_SOURCE)
+#define	_GNU_SOURCE		// CPU_SET, pthread_setaffinity_np
+#endif
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "mod_hamradio.h"
+
+#define	RT_SELFTEST_PERIOD_NS	1000000		// 1ms
+
+static RadioHist_t rt_jitter;			// us late, per wakeup
+static int rt_locked = 0;			// mlockall() is per process, only do it once
+
+// "2-3" or "0,2" or "3" -> cpu set, returns number of CPUs set
+static int rt_parse_cpus(const char *spec, cpu_set_t *set) {
+   const char *p = spec;
+   int n = 0;
+
+   CPU_ZERO(set);
+
+   while (*p) {
+      char *end;
+      long lo = strtol(p, &end, 10), hi;
+
+      if (end == p) {
+         return -1;
+      }
+
+      hi = lo;
+      p = end;
+
+      if (*p == '-') {
+         p++;
+         hi = strtol(p, &end, 10);
+
+         if (end == p) {
+            return -1;
+         }
+         p = end;
+      }
+
+      if (lo < 0 || hi < lo || hi >= CPU_SETSIZE) {
+         return -1;
+      }
+
+      for (long cpu = lo; cpu <= hi; cpu++) {
+         CPU_SET(cpu, set);
+         n++;
+      }
+
+      while (*p == ',' || *p == ' ') {
+         p++;
+      }
+   }
+
+   return n;
+}
+
+switch_status_t radio_rt_apply(const char *who) {
+   switch_status_t rv = SWITCH_STATUS_SUCCESS;
+   struct sched_param sp;
+   const char *policy_s, *cpus;
+   int policy = SCHED_OTHER, prio, lock, err;
+   CfgGeneral_t *cfg = dconf_hold();
+
+   // The strings point into cfg, which stays put until we release it
+   policy_s = dconf_str(cfg, "rt_policy", "other");
+   prio = dconf_held_int(cfg, CFGH_RT_PRIORITY);
+   cpus = dconf_str(cfg, "cpu_affinity", NULL);
+   lock = dconf_held_int(cfg, CFGH_MLOCKALL);
+
+   if (strcasecmp(policy_s, "fifo") == 0) {
+      policy = SCHED_FIFO;
+   } else if (strcasecmp(policy_s, "rr") == 0) {
+      policy = SCHED_RR;
+   } else if (strcasecmp(policy_s, "other") != 0) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[rt] rt_policy '%s' is not valid (other, fifo, rr), leaving %s alone\n", policy_s, who);
+      policy = -1;
+   }
+
+   if (policy == SCHED_FIFO || policy == SCHED_RR) {
+      if (prio < sched_get_priority_min(policy) || prio > sched_get_priority_max(policy)) {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "[rt] rt_priority %d out of range, using 50\n", prio);
+         prio = 50;
+      }
+
+      memset(&sp, 0, sizeof(sp));
+      sp.sched_priority = prio;
+
+      if ((err = pthread_setschedparam(pthread_self(), policy, &sp)) != 0) {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[rt] can't make %s %s/%d: %s (needs CAP_SYS_NICE or an rtprio limit)\n", who, policy_s, prio, strerror(err));
+         rv = SWITCH_STATUS_FALSE;
+      } else {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "[rt] %s running %s priority %d\n", who, policy_s, prio);
+      }
+   }
+
+   if (!zstr(cpus)) {
+      cpu_set_t set;
+
+      if (rt_parse_cpus(cpus, &set) <= 0) {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[rt] cpu_affinity '%s' is not valid\n", cpus);
+         rv = SWITCH_STATUS_FALSE;
+      } else if ((err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) != 0) {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[rt] can't pin %s to CPU(s) %s: %s\n", who, cpus, strerror(err));
+         rv = SWITCH_STATUS_FALSE;
+      } else {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "[rt] %s pinned to CPU(s) %s\n", who, cpus);
+      }
+   }
+
+   if (lock && !rt_locked) {
+      if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[rt] mlockall failed: %s (check RLIMIT_MEMLOCK)\n", strerror(errno));
+         rv = SWITCH_STATUS_FALSE;
+      } else {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "[rt] process memory locked\n");
+         rt_locked = 1;
+      }
+   }
+
+   dconf_release(cfg);
+   return rv;
+}
+
+void radio_rt_selftest(void) {
+   struct timespec next;
+   int count;
+
+   count = dconf_int(CFGH_RT_SELFTEST);
+
+   if (count <= 0) {
+      return;
+   }
+
+   radio_hist_reset(&rt_jitter);
+   clock_gettime(CLOCK_MONOTONIC, &next);
+
+   for (int i = 0; i < count && globals.alive; i++) {
+      struct timespec now;
+      int64_t late;
+
+      next.tv_nsec += RT_SELFTEST_PERIOD_NS;
+
+      if (next.tv_nsec >= 1000000000) {
+         next.tv_sec++;
+         next.tv_nsec -= 1000000000;
+      }
+
+      while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR) {
+         ;
+      }
+
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      late = ((int64_t)(now.tv_sec - next.tv_sec) * 1000000000) + (now.tv_nsec - next.tv_nsec);
+      radio_hist_add(&rt_jitter, (late > 0 ? late / 1000 : 0));
+   }
+
+   switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "[rt] wakeup jitter over %" PRIu64 " 1ms sleeps: p50=%" PRIu64 " us p99=%" PRIu64 " us max=%" PRIu64 " us\n",
+      rt_jitter.count, radio_hist_percentile(&rt_jitter, 50), radio_hist_percentile(&rt_jitter, 99), rt_jitter.max);
+}
+
+void radio_rt_print_jitter(switch_stream_handle_t *stream) {
+   if (__atomic_load_n(&rt_jitter.count, __ATOMIC_RELAXED) == 0) {
+      return;
+   }
+
+   stream->write_function(stream, "runtime thread wakeup jitter (startup self-check):\n");
+   stream->write_function(stream, "   %-14s n=%-8" PRIu64 " p50=%8" PRIu64 " us  p99=%8" PRIu64 " us  max=%8" PRIu64 " us\n", "1ms sleep",
+      __atomic_load_n(&rt_jitter.count, __ATOMIC_RELAXED), radio_hist_percentile(&rt_jitter, 50), radio_hist_percentile(&rt_jitter, 99),
+      __atomic_load_n(&rt_jitter.max, __ATOMIC_RELAXED));
+}
@@ -0,0 +1,27 @@
+#if	!defined(RADIO_RT_H)
+#define	RADIO_RT_H
+
+//
+// Real-time settings for our threads
+//
+// From [general]:
+//	rt_policy	other (default), fifo or rr
+//	rt_priority	1-99, for fifo/rr (default 50)
+//	cpu_affinity	CPUs to run on, ex: 3 or 2-3 or 0,2 (default: any)
+//	mlockall	lock the process' memory so we never page fault on a PTT release
+//	rt_selftest	1ms sleeps to time at startup, 0 to skip (default 200)
+//
+// The runtime thread applies these to itself when it starts, then measures
+// how late a 1ms sleep actually wakes up. The result shows up in the log and
+// at the top of "hamradio latency".
+//
+
+// Apply the configured policy/priority/affinity to the calling thread
+extern switch_status_t radio_rt_apply(const char *who);
+
+// Time a batch of 1ms sleeps and log how late they were
+extern void radio_rt_selftest(void);
+
+extern void radio_rt_print_jitter(switch_stream_handle_t *stream);
+
+#endif	// !defined(RADIO_RT_H)
@@ -0,0 +1,85 @@
+/*
+ * Squelch debounce and hysteresis
+ *
+ * Noisy COS lines used to make radios flap between RX and IDLE, with every
+ * flap writing GPIO and logging. Here each radio runs a small state machine
+ * on the timestamps the kernel attaches to gpiod edge events, and only
+ * passes changes that stick on to the runtime core.
+ */
+#include "mod_hamradio.h"
+
+#define	MS_TO_NS(x)	((uint64_t)(x) * 1000000)
+
+uint64_t radio_now_ns(void) {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+// Believe the raw level
+static void radio_squelch_commit(const int radio, SquelchDebounce_t *sq, const uint64_t now_ns) {
+   sq->state = sq->raw;
+   sq->changed = now_ns;
+   radio_core_squelch(radio, sq->state, time(NULL));
+}
+
+// The open/close delay (or minimum hold) ran out
+static void radio_squelch_expired(const int radio, void *data) {
+   SquelchDebounce_t *sq = &Radios(radio).squelch;
+
+   if (sq->raw != sq->state) {
+      radio_squelch_commit(radio, sq, radio_now_ns());
+   }
+}
+
+void radio_squelch_setup(const int radio) {
+   radio_timer_setup(&Radios(radio).squelch.timer, "squelch", radio, radio_squelch_expired, NULL);
+}
+
+void radio_squelch_reset(const int radio, const int level) {
+   SquelchDebounce_t *sq = &Radios(radio).squelch;
+
+   radio_timer_cancel(&sq->timer);
+   sq->raw = sq->state = (level > 0);
+   sq->raw_since = sq->changed = radio_now_ns();
+}
+
+void radio_squelch_edge(const int radio, const int level, const uint64_t ts_ns) {
+   SquelchDebounce_t *sq = &Radios(radio).squelch;
+   uint64_t due, now_ns;
+
+   sq->edges++;
+
+   // Same level twice (we missed the edge between), nothing changed
+   if (level == sq->raw) {
+      return;
+   }
+
+   sq->raw = level;
+   sq->raw_since = ts_ns;
+
+   // Flipped back before the change was believed, throw it away
+   if (level == sq->state) {
+      if (radio_timer_armed(&sq->timer)) {
+         radio_timer_cancel(&sq->timer);
+         sq->glitches++;
+         radio_stat_inc(Radios(radio).cold->stats.ctr->squelch_flaps);
+      }
+      return;
+   }
+
+   // When can we believe it? After the open/close delay, but not before min_hold is up
+   due = ts_ns + MS_TO_NS(level ? sq->open_delay : sq->close_delay);
+
+   if (sq->changed + MS_TO_NS(sq->min_hold) > due) {
+      due = sq->changed + MS_TO_NS(sq->min_hold);
+   }
+
+   if (due <= (now_ns = radio_now_ns())) {
+      radio_squelch_commit(radio, sq, now_ns);
+   } else {
+      // round up, better a hair late than early
+      radio_timer_arm(&sq->timer, (due - now_ns + 999999) / 1000000);
+   }
+}
@@ -0,0 +1,41 @@
+#if	!defined(RADIO_SQUELCH_H)
+#define	RADIO_SQUELCH_H
+#include <stdint.h>
+
+//
+// Squelch debounce / hysteresis
+//
+// Raw COS/TOS edges (with the kernel's timestamps) go in, a clean open/closed
+// state comes out. A change has to persist for open_delay/close_delay before
+// it's believed, and the debounced state is held at least min_hold once it
+// changes. Edges that flip back before that are counted as glitches.
+//
+struct SquelchDebounce {
+   // configuration (ms)
+   u_int32_t	open_delay;		// squelch must stay open this long before we call it RX
+   u_int32_t	close_delay;		// ... or closed this long before we drop RX
+   u_int32_t	min_hold;		// minimum time between debounced changes
+
+   // run-time state
+   int		raw;			// last level seen on the line (1 = open)
+   int		state;			// debounced level
+   uint64_t	raw_since;		// kernel timestamp of the last raw change (ns, monotonic)
+   uint64_t	changed;		// when the debounced state last changed (ns, monotonic)
+   RadioTimer_t	timer;			// pending commit of raw -> state
+
+   // statistics
+   u_int32_t	edges;			// edges seen on the line
+   u_int32_t	glitches;		// edges rejected because they didn't last
+};
+typedef struct SquelchDebounce SquelchDebounce_t;
+
+// Monotonic clock, in nanoseconds (same clock gpiod stamps edges with)
+extern uint64_t radio_now_ns(void);
+
+extern void radio_squelch_setup(const int radio);
+// Forget any history and start from a known level
+extern void radio_squelch_reset(const int radio, const int level);
+// A raw edge came in from the line
+extern void radio_squelch_edge(const int radio, const int level, const uint64_t ts_ns);
+
+#endif	// !defined(RADIO_SQUELCH_H)
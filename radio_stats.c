@@ -0,0 +1,97 @@
+/*
+ * Per-radio traffic statistics
+ */
+#include "mod_hamradio.h"
+
+#define	IS_TX(x)	((x) == RADIO_TX || (x) == RADIO_TX_DATA)
+
+void radio_stats_attach(Radio_t *r, const int radio) {
+   RadioStats_t *st = &r->cold->stats;
+   RadioCounters_t *ctr;
+
+   // No file, or already attached
+   if (!(ctr = radio_persist_slot(radio)) || st->ctr == ctr) {
+      return;
+   }
+
+   st->ctr = ctr;
+
+   // Pick up where the last run left off
+   r->last_rx = st->ctr->last_rx;
+   r->last_tx = st->ctr->last_tx;
+   r->cold->total_rx = st->ctr->rx_ms_total / 1000;
+   r->cold->total_tx = st->ctr->tx_ms_total / 1000;
+}
+
+void radio_stats_transition(RadioStats_t *st, const int old, const int new) {
+   RadioCounters_t *ctr = st->ctr;
+   uint64_t now = radio_now_ms();
+
+   // A session is over, how long was it?
+   if (old == RADIO_RX && new != RADIO_RX) {
+      radio_hist_add(&st->rx_ms, now - st->rx_since);
+      __atomic_add_fetch(&ctr->rx_ms_total, now - st->rx_since, __ATOMIC_RELAXED);
+      __atomic_store_n(&ctr->last_rx, (int64_t)time(NULL), __ATOMIC_RELAXED);
+   } else if (IS_TX(old) && !IS_TX(new)) {
+      radio_hist_add(&st->tx_ms, now - st->tx_since);
+      __atomic_add_fetch(&ctr->tx_ms_total, now - st->tx_since, __ATOMIC_RELAXED);
+      __atomic_store_n(&ctr->last_tx, (int64_t)time(NULL), __ATOMIC_RELAXED);
+   }
+
+   // ... or just starting?
+   if (new == RADIO_RX && old != RADIO_RX) {
+      radio_stat_inc(ctr->rx_sessions);
+      st->rx_since = now;
+   } else if (IS_TX(new) && !IS_TX(old)) {
+      radio_stat_inc(ctr->tx_sessions);
+      st->tx_since = now;
+   }
+}
+
+static void radio_stats_print_hist(switch_stream_handle_t *stream, const char *name, RadioHist_t *h) {
+   uint64_t count = __atomic_load_n(&h->count, __ATOMIC_RELAXED);
+
+   stream->write_function(stream, "   %-14s n=%-8" PRIu64 " avg=%8" PRIu64 " ms  p50=%8" PRIu64 " ms  p90=%8" PRIu64 " ms  p99=%8" PRIu64 " ms  max=%8" PRIu64 " ms\n", name, count,
+      (count ? __atomic_load_n(&h->sum, __ATOMIC_RELAXED) / count : 0),
+      radio_hist_percentile(h, 50), radio_hist_percentile(h, 90), radio_hist_percentile(h, 99),
+      __atomic_load_n(&h->max, __ATOMIC_RELAXED));
+}
+
+void radio_stats_print(switch_stream_handle_t *stream, const int radio) {
+   RadioStats_t *st;
+
+   if (!radio_exists(radio)) {
+      stream->write_function(stream, "invalid radio %d specified\n", radio);
+      return;
+   }
+
+   st = &Radios(radio).cold->stats;
+   stream->write_function(stream, "radio%d:%s\n", radio, (st->ctr == &st->local ? "" : " (persistent)"));
+   stream->write_function(stream, "   rx sessions: %-8" PRIu64 " tx sessions: %-8" PRIu64 " tot trips: %-8" PRIu64 " ptt blocked: %-8" PRIu64 " squelch flaps: %" PRIu64 "\n",
+      __atomic_load_n(&st->ctr->rx_sessions, __ATOMIC_RELAXED), __atomic_load_n(&st->ctr->tx_sessions, __ATOMIC_RELAXED),
+      __atomic_load_n(&st->ctr->tot_trips, __ATOMIC_RELAXED), __atomic_load_n(&st->ctr->ptt_blocked, __ATOMIC_RELAXED),
+      __atomic_load_n(&st->ctr->squelch_flaps, __ATOMIC_RELAXED));
+   stream->write_function(stream, "   rx total: %" PRIu64 " s\t\ttx total: %" PRIu64 " s\n",
+      __atomic_load_n(&st->ctr->rx_ms_total, __ATOMIC_RELAXED) / 1000, __atomic_load_n(&st->ctr->tx_ms_total, __ATOMIC_RELAXED) / 1000);
+   radio_stats_print_hist(stream, "rx duration", &st->rx_ms);
+   radio_stats_print_hist(stream, "tx duration", &st->tx_ms);
+}
+
+void radio_stats_reset(const int radio) {
+   RadioStats_t *st;
+
+   if (!radio_exists(radio)) {
+      err_invalid_radio(radio);
+      return;
+   }
+
+   // Running totals and last activity times are kept, only the counts start over
+   st = &Radios(radio).cold->stats;
+   __atomic_store_n(&st->ctr->rx_sessions, 0, __ATOMIC_RELAXED);
+   __atomic_store_n(&st->ctr->tx_sessions, 0, __ATOMIC_RELAXED);
+   __atomic_store_n(&st->ctr->tot_trips, 0, __ATOMIC_RELAXED);
+   __atomic_store_n(&st->ctr->ptt_blocked, 0, __ATOMIC_RELAXED);
+   __atomic_store_n(&st->ctr->squelch_flaps, 0, __ATOMIC_RELAXED);
+   radio_hist_reset(&st->rx_ms);
+   radio_hist_reset(&st->tx_ms);
+}
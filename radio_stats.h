@@ -0,0 +1,51 @@
+#if	!defined(RADIO_STATS_H)
+#define	RADIO_STATS_H
+
+//
+// Per-radio traffic statistics
+//
+// Counted by the state machine with relaxed atomics, so "hamradio stats" can
+// read them from any thread without stopping anything. Durations are in ms,
+// for sizing timeout_talk and timeout_holdoff from real traffic.
+//
+// Counters that outlive the module (see radio_persist.h). Plain integers only,
+// this is the on-disk layout.
+struct RadioCounters {
+   uint64_t	rx_sessions;		// times we went into RX
+   uint64_t	tx_sessions;		// ... and into TX (or TX_DATA)
+   uint64_t	tot_trips;		// TX cut short by the TOT
+   uint64_t	ptt_blocked;		// TX refused while a penalty was running
+   uint64_t	squelch_flaps;		// squelch edges that didn't last past the debounce
+   uint64_t	rx_ms_total;		// time spent receiving, all sessions
+   uint64_t	tx_ms_total;		// ... and transmitting
+   int64_t	last_rx;		// end of the last RX (time_t)
+   int64_t	last_tx;		// ... and TX
+} __attribute__((aligned(64)));
+typedef struct RadioCounters RadioCounters_t;
+
+struct RadioStats {
+   RadioCounters_t *ctr;		// in the counters file, or &local if there isn't one
+   RadioCounters_t local;
+
+   uint64_t	rx_since;		// when the current RX started (radio_now_ms)
+   uint64_t	tx_since;		// ... and TX
+
+   RadioHist_t	rx_ms;			// how long each RX lasted
+   RadioHist_t	tx_ms;			// ... and each TX
+} __attribute__((aligned(64)));
+typedef struct RadioStats RadioStats_t;
+
+struct Radio;
+
+#define	radio_stat_inc(x)	__atomic_add_fetch(&(x), 1, __ATOMIC_RELAXED)
+
+// Hook a new radio's counters up to its slot in the counters file
+extern void radio_stats_attach(struct Radio *r, const int radio);
+
+// Count sessions and time them (state machine only)
+extern void radio_stats_transition(RadioStats_t *st, const int old, const int new);
+
+extern void radio_stats_print(switch_stream_handle_t *stream, const int radio);
+extern void radio_stats_reset(const int radio);
+
+#endif	// !defined(RADIO_STATS_H)
@@ -0,0 +1,194 @@
+/*
+ * Pre-rendered status fragments for hamradio status
+ */
+#include "mod_hamradio.h"
+
+static switch_mutex_t *status_mutex = NULL;	// fragments are rebuilt in place
+
+// Copy s into a JSON string body (no quotes), never writing past len
+static size_t json_escape(char *out, const size_t len, const char *s) {
+   size_t o = 0;
+
+   for (; *s && o + 7 < len; s++) {
+      unsigned char c = (unsigned char)*s;
+
+      if (c == '"' || c == '\\') {
+         out[o++] = '\\';
+         out[o++] = c;
+      } else if (c < 0x20) {
+         o += snprintf(out + o, len - o, "\\u%04x", c);
+      } else {
+         out[o++] = c;
+      }
+   }
+
+   out[o] = '\0';
+   return o;
+}
+
+static void fmt_time(char *buf, const size_t len, const time_t t) {
+   struct tm tm;
+
+   if (t <= 0) {
+      snprintf(buf, len, "never");
+   } else {
+      strftime(buf, len, "%Y-%m-%dT%H:%M:%S", localtime_r(&t, &tm));
+   }
+}
+
+// Builds the (open) JSON object, false if it didn't fit
+static switch_bool_t status_build_json(const int radio, Radio_t *r, const RadioSnapshot_t *snap, RadioStatusCache_t *c, const char *desc, const time_t penalty_end) {
+   int n = snprintf(c->json, sizeof(c->json),
+      "{\"radio\":%d,\"description\":\"%s\",\"enabled\":%s,\"status\":\"%s\","
+      "\"last_rx\":%ld,\"last_tx\":%ld,\"last_id\":%ld,\"rx_since\":%ld,\"tx_since\":%ld,"
+      "\"total_rx\":%ld,\"total_tx\":%ld,\"penalty_until\":%ld,\"tot\":%ld,\"holdoff\":%ld,"
+      "\"squelch_mode\":%d,\"gpio\":{\"ptt\":%d,\"power\":%d,\"squelch\":%d}",
+      radio, desc, (snap->enabled ? "true" : "false"), radio_status_name(snap->status),
+      (long)snap->last_rx, (long)snap->last_tx, (long)snap->last_id,
+      (long)(snap->status == RADIO_RX ? snap->listen_start : 0), (long)snap->talk_start,
+      (long)snap->total_rx, (long)snap->total_tx, (long)penalty_end,
+      (long)r->timeout_talk, (long)r->timeout_holdoff,
+      r->RX_mode, r->pin_ptt, r->pin_power, r->pin_squelch);
+
+   if (n < 0 || (size_t)n >= sizeof(c->json)) {
+      return false;
+   }
+
+   c->json_len = n;
+   return true;
+}
+
+static void status_build(const int radio, Radio_t *r, const RadioSnapshot_t *snap, RadioStatusCache_t *c) {
+   char desc[2 * sizeof(r->cold->description)], rx[32], tx[32];
+   time_t penalty = radio_snapshot_penalty(snap);
+   time_t penalty_end = (penalty > 0 ? time(NULL) + penalty : 0);
+   switch_bool_t fits = true;
+   int n;
+
+   json_escape(desc, sizeof(desc), r->cold->description);
+
+   // A cut off object would be broken JSON: say it without the description instead
+   if (!status_build_json(radio, r, snap, c, desc, penalty_end)) {
+      fits = false;
+      status_build_json(radio, r, snap, c, "", penalty_end);
+   }
+
+   fmt_time(rx, sizeof(rx), snap->last_rx);
+   fmt_time(tx, sizeof(tx), snap->last_tx);
+   n = snprintf(c->text, sizeof(c->text), "radio%d %s %s last_rx=%s last_tx=%s penalty_until=%ld \"%s\"\n",
+      radio, (snap->enabled ? "enabled" : "disabled"), radio_status_name(snap->status), rx, tx, (long)penalty_end, r->cold->description);
+
+   if (n < 0) {
+      n = 0;
+      fits = false;
+   } else if ((size_t)n >= sizeof(c->text)) {
+      // Still one line
+      n = sizeof(c->text) - 1;
+      c->text[n - 1] = '\n';
+      fits = false;
+   }
+   c->text_len = n;
+
+   c->seq = snap->seq;
+   c->generation = globals.gpio_generation;
+
+   // Anything that had to be cut short is built again next time, never cached
+   c->valid = fits;
+}
+
+// Fragment for one radio, rebuilt only if the radio changed. Hold status_mutex.
+static RadioStatusCache_t *status_fragment(const int radio, RadioSnapshot_t *snap) {
+   Radio_t *r;
+   RadioStatusCache_t *c;
+
+   if (radio_snapshot(radio, snap) != SWITCH_STATUS_SUCCESS) {
+      return NULL;
+   }
+
+   r = &Radios(radio);
+   c = &r->cold->status;
+
+   if (!c->valid || c->seq != snap->seq || c->generation != globals.gpio_generation) {
+      status_build(radio, r, snap, c);
+   }
+
+   return c;
+}
+
+static void status_write(switch_stream_handle_t *stream, const char *buf, const size_t len) {
+   if (stream->raw_write_function) {
+      stream->raw_write_function(stream, (uint8_t *)buf, len);
+   } else {
+      stream->write_function(stream, "%.*s", (int)len, buf);
+   }
+}
+
+switch_status_t radio_status_render(switch_stream_handle_t *stream, const int radio, const RadioStatusFormat_t fmt) {
+   RadioStatusCache_t *c;
+   RadioSnapshot_t snap;
+   int active = 0, shown = 0;
+
+   if (!status_mutex) {
+      switch_mutex_lock(globals.mutex);
+      if (!status_mutex) {
+         switch_mutex_init(&status_mutex, SWITCH_MUTEX_UNNESTED, globals.pool);
+      }
+      switch_mutex_unlock(globals.mutex);
+   }
+
+   if (radio >= 0 && !radio_exists(radio)) {
+      return SWITCH_STATUS_FALSE;
+   }
+
+   switch_mutex_lock(status_mutex);
+
+   if (fmt == STATUS_JSON && radio < 0) {
+      status_write(stream, "{\"radios\":[", 11);
+   }
+
+   for (int i = (radio >= 0 ? radio : 0); i < globals.max_radios; i++) {
+      if ((c = status_fragment(i, &snap)) != NULL) {
+         if (fmt == STATUS_JSON) {
+            if (shown > 0) {
+               status_write(stream, ",", 1);
+            }
+            status_write(stream, c->json, c->json_len);
+
+            // The duty cycle budget moves without the state changing, so it's never cached
+            if (Radios(i).cold->duty.pct > 0) {
+               char duty[48];
+               int len = snprintf(duty, sizeof(duty), ",\"duty_left\":%ld}", (long)radio_duty_remaining(i));
+
+               status_write(stream, duty, len);
+            } else {
+               status_write(stream, "}", 1);
+            }
+         } else {
+            status_write(stream, c->text, c->text_len);
+         }
+
+         shown++;
+         if (snap.enabled && snap.status > RADIO_OFF) {
+            active++;
+         }
+      }
+
+      if (radio >= 0) {
+         break;
+      }
+   }
+
+   switch_mutex_unlock(status_mutex);
+
+   if (fmt == STATUS_JSON) {
+      if (radio < 0) {
+         stream->write_function(stream, "],\"active\":%d,\"max_radios\":%d}\n", active, globals.max_radios);
+      } else {
+         status_write(stream, "\n", 1);
+      }
+   } else if (radio < 0) {
+      stream->write_function(stream, "%d/%d units active\n", active, globals.max_radios);
+   }
+
+   return SWITCH_STATUS_SUCCESS;
+}
@@ -0,0 +1,39 @@
+#if	!defined(RADIO_STATUS_H)
+#define	RADIO_STATUS_H
+
+//
+// hamradio status, for people and for programs
+//
+// Each radio keeps its status pre-rendered (JSON and one compact line). A
+// fragment is only rebuilt when the radio's state_seq (or the configuration
+// generation) has moved on since it was made, so a dashboard polling every
+// radio mostly gets a copy of bytes that are already there. Times are
+// absolute (epoch seconds), which is what keeps a fragment valid while the
+// radio sits still. The JSON object is kept open (no closing brace), so the
+// fields that move on their own can be added when it's written out.
+//
+// Big enough for the longest description (every character escaped) and every
+// number at its widest; anything that still doesn't fit is never cached.
+#define	RADIO_STATUS_JSON_MAX	1280
+#define	RADIO_STATUS_TEXT_MAX	512
+
+typedef enum RadioStatusFormat {
+   STATUS_COMPACT = 0,
+   STATUS_JSON
+} RadioStatusFormat_t;
+
+struct RadioStatusCache {
+   uint32_t	seq;			// state_seq the fragments were built from
+   int		generation;		// ... and globals.gpio_generation (config reloads)
+   switch_bool_t valid;		// false: never built, or didn't fit
+   size_t	json_len;
+   size_t	text_len;
+   char		json[RADIO_STATUS_JSON_MAX];
+   char		text[RADIO_STATUS_TEXT_MAX];
+};
+typedef struct RadioStatusCache RadioStatusCache_t;
+
+// radio < 0 for every radio
+extern switch_status_t radio_status_render(switch_stream_handle_t *stream, const int radio, const RadioStatusFormat_t fmt);
+
+#endif	// !defined(RADIO_STATUS_H)
@@ -0,0 +1,288 @@
+/*
+ * Radio table and its grace periods
+ *
+ * The table of radios is copied and republished whenever a radio is added
+ * or removed, so readers never need a lock to look at it (see radio_table.h).
+ * Whatever falls out of the table is parked on the retired list until
+ * radio_rcu_reclaim() has waited out every reader that might still have it.
+ *
+ * The hot half of every radio lives in radio_hot[], indexed by radio #, so
+ * the runtime thread's scans stay on a handful of contiguous cache lines. A
+ * removed radio's element is only handed out again after a grace period.
+ *
+ * Readers count themselves in one of two epochs. A grace period waits for
+ * stragglers in the idle epoch, flips the current one, then waits for the
+ * old epoch to empty. Readers always load the table after counting
+ * themselves, so anyone who got in late can only see the new table.
+ */
+#include "mod_hamradio.h"
+
+struct RetiredItem {
+   struct RetiredItem *next;
+   void *ptr;
+   void (*release)(void *ptr);		// how to let go of ptr (free() if NULL)
+};
+
+static struct {
+   int epoch;					// which readers[] new readers count in
+   int readers[2];
+   struct RetiredItem *retired;			// waiting for a grace period
+   switch_mutex_t *sync_mutex;			// one grace period at a time
+} rcu;
+
+// Removed radios leave this behind in their slot, so a reader that checked
+// radio_exists() against the previous table only ever finds a radio that is off
+// (its counters point at its own local copy, like any live radio's before attach)
+static RadioCold_t radio_removed_cold = { .stats.ctr = &radio_removed_cold.stats.local };
+static Radio_t radio_removed = { .pin_power = -1, .pin_ptt = -1, .pin_squelch = -1, .cold = &radio_removed_cold };
+
+// Hot halves of the radios, and which of them are taken (or waiting out a grace period)
+static Radio_t radio_hot[RADIO_TABLE_MAX];
+static int radio_hot_busy[RADIO_TABLE_MAX];
+
+// Their writer mutexes, made once for every slot (pool memory is only given back at unload)
+static switch_mutex_t *radio_hot_mutex[RADIO_TABLE_MAX];
+static switch_memory_pool_t *radio_hot_mutex_pool;
+
+////////////
+// Readers //
+////////////
+int radio_rcu_read_lock(void) {
+   int idx = __atomic_load_n(&rcu.epoch, __ATOMIC_SEQ_CST) & 1;
+
+   __atomic_add_fetch(&rcu.readers[idx], 1, __ATOMIC_SEQ_CST);
+   return idx;
+}
+
+void radio_rcu_read_unlock(const int idx) {
+   __atomic_sub_fetch(&rcu.readers[idx & 1], 1, __ATOMIC_RELEASE);
+}
+
+static void rcu_wait_readers(const int idx) {
+   while (__atomic_load_n(&rcu.readers[idx], __ATOMIC_ACQUIRE) > 0) {
+      switch_yield(1000);
+   }
+}
+
+// Wait until every read section that was open when we were called has closed
+void radio_rcu_synchronize(void) {
+   int cur;
+
+   if (!rcu.sync_mutex) {
+      switch_mutex_init(&rcu.sync_mutex, SWITCH_MUTEX_UNNESTED, globals.pool);
+   }
+
+   switch_mutex_lock(rcu.sync_mutex);
+   cur = __atomic_load_n(&rcu.epoch, __ATOMIC_SEQ_CST) & 1;
+
+   // Readers who picked the idle epoch before the last flip but counted themselves after it
+   rcu_wait_readers(cur ^ 1);
+
+   __atomic_store_n(&rcu.epoch, cur ^ 1, __ATOMIC_SEQ_CST);
+   rcu_wait_readers(cur);
+   switch_mutex_unlock(rcu.sync_mutex);
+}
+
+// Hand ptr to release() (or free() it) after the next grace period
+void radio_rcu_retire_fn(void *ptr, void (*release)(void *ptr)) {
+   struct RetiredItem *item;
+
+   if (ptr == NULL) {
+      return;
+   }
+
+   if (!(item = malloc(sizeof(*item)))) {
+      // Better to leak it than free it under a reader
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[radio] out of memory retiring %p, leaking it\n", ptr);
+      return;
+   }
+
+   item->ptr = ptr;
+   item->release = release;
+   item->next = __atomic_load_n(&rcu.retired, __ATOMIC_RELAXED);
+
+   while (!__atomic_compare_exchange_n(&rcu.retired, &item->next, item, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+      ;
+   }
+}
+
+// Free ptr after the next grace period
+void radio_rcu_retire(void *ptr) {
+   radio_rcu_retire_fn(ptr, NULL);
+}
+
+// Free everything retired so far, waiting out readers first
+void radio_rcu_reclaim(void) {
+   struct RetiredItem *item = __atomic_exchange_n(&rcu.retired, NULL, __ATOMIC_ACQ_REL);
+
+   if (item == NULL) {
+      return;
+   }
+
+   radio_rcu_synchronize();
+
+   while (item) {
+      struct RetiredItem *next = item->next;
+
+      if (item->release) {
+         item->release(item->ptr);
+      } else {
+         free(item->ptr);
+      }
+      free(item);
+      item = next;
+   }
+}
+
+/////////////
+// Lookups //
+/////////////
+switch_bool_t radio_exists(const int radio) {
+   RadioTable_t *t = radio_table();
+
+   return (t != NULL && radio >= 0 && radio < t->size && t->radio[radio] != NULL && t->radio[radio] != &radio_removed);
+}
+
+/////////////
+// Writers //
+/////////////
+// Copy the current table into one with (at least) size slots
+static RadioTable_t *table_copy(const RadioTable_t *old, int size) {
+   RadioTable_t *t;
+
+   if (old && old->size > size) {
+      size = old->size;
+   }
+
+   if (!(t = calloc(1, sizeof(*t) + (sizeof(Radio_t *) * size)))) {
+      return NULL;
+   }
+
+   t->size = size;
+
+   if (old) {
+      memcpy(t->radio, old->radio, sizeof(Radio_t *) * old->size);
+      t->version = old->version + 1;
+   }
+
+   return t;
+}
+
+// Nobody can see this radio any more, its radio_hot[] element can be reused
+static void radio_hot_release(void *ptr) {
+   Radio_t *r = ptr;
+
+   __atomic_store_n(&radio_hot_busy[r - radio_hot], 0, __ATOMIC_RELEASE);
+}
+
+static void table_publish(RadioTable_t *t, RadioTable_t *old) {
+   __atomic_store_n(&globals.radios, t, __ATOMIC_SEQ_CST);
+
+   // Loops over max_radios must never run past the end of the table they see
+   if (t->size > globals.max_radios) {
+      __atomic_store_n(&globals.max_radios, t->size, __ATOMIC_RELEASE);
+   }
+
+   radio_rcu_retire(old);
+}
+
+// Get the radio in a slot, creating it (and growing the table) if it isn't there yet
+Radio_t *radio_table_slot(const int radio) {
+   RadioTable_t *old = radio_table(), *t;
+   Radio_t *r;
+
+   if (radio < 0 || radio >= RADIO_TABLE_MAX) {
+      return NULL;
+   }
+
+   if (radio_exists(radio)) {
+      return old->radio[radio];
+   }
+
+   // First table since we were loaded: every slot gets its mutex now, and keeps it through remove/re-add
+   if (radio_hot_mutex_pool != globals.pool) {
+      for (int i = 0; i < RADIO_TABLE_MAX; i++) {
+         switch_mutex_init(&radio_hot_mutex[i], SWITCH_MUTEX_UNNESTED, globals.pool);
+      }
+      radio_hot_mutex_pool = globals.pool;
+   }
+
+   if (__atomic_load_n(&radio_hot_busy[radio], __ATOMIC_ACQUIRE)) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "radio%d is still being removed, try again in a moment\n", radio);
+      return NULL;
+   }
+
+   r = &radio_hot[radio];
+   memset(r, 0, sizeof(*r));
+
+   if (!(r->cold = calloc(1, sizeof(*r->cold)))) {
+      return NULL;
+   }
+
+   if (!(t = table_copy(old, (radio >= globals.max_radios ? radio + 1 : globals.max_radios)))) {
+      free(r->cold);
+      r->cold = NULL;
+      return NULL;
+   }
+
+   radio_hot_busy[radio] = 1;
+
+   // No GPIO lines unless configured
+   r->pin_power = r->pin_ptt = r->pin_squelch = -1;
+
+   // Counters stay in memory until radio_stats_attach() finds them a home
+   r->cold->stats.ctr = &r->cold->stats.local;
+
+   // Serializes writers of the run-time state (see radio_state_write_begin)
+   r->mutex = radio_hot_mutex[radio];
+
+   t->radio[radio] = r;
+   table_publish(t, old);
+   return r;
+}
+
+// Shut a radio down and take it out of the table. Caller rebuilds GPIO afterwards.
+switch_status_t radio_table_remove(const int radio) {
+   RadioTable_t *old = radio_table(), *t;
+   Radio_t *r;
+
+   if (!radio_exists(radio)) {
+      return SWITCH_STATUS_FALSE;
+   }
+
+   r = old->radio[radio];
+
+   if (!(t = table_copy(old, old->size))) {
+      return SWITCH_STATUS_MEMERR;
+   }
+
+   // Drop PTT and power while we still can
+   radio_set_state(radio, RADIO_OFF);
+   radio_state_write_begin(r);
+   r->enabled = false;
+   radio_state_write_end(r);
+
+   radio_timer_cancel(&r->tot_timer);
+   radio_timer_cancel(&r->penalty_timer);
+   radio_timer_cancel(&r->id_timer);
+   radio_timer_cancel(&r->squelch.timer);
+   radio_timer_cancel(&r->cold->notify.timer);
+   radio_timer_cancel(&r->cold->duty.timer);
+
+   r->gpio_power = r->gpio_ptt = r->gpio_squelch = NULL;
+
+   t->radio[radio] = &radio_removed;
+   table_publish(t, old);
+   radio_table_retire(r);
+   return SWITCH_STATUS_SUCCESS;
+}
+
+// Free a radio (both halves) once no reader can be looking at it any more
+void radio_table_retire(Radio_t *r) {
+   if (r == NULL || r == &radio_removed) {
+      return;
+   }
+
+   radio_rcu_retire(r->cold);
+   radio_rcu_retire_fn(r, radio_hot_release);
+}
@@ -0,0 +1,56 @@
+#if	!defined(RADIO_TABLE_H)
+#define	RADIO_TABLE_H
+
+//
+// Versioned radio table
+//
+// Radios are allocated one at a time and hung off a table of pointers, so
+// adding one (or growing the table) never moves an existing Radio_t. The
+// table is only ever replaced, never modified in place: writers build a copy,
+// publish it, and retire the old table (and any removed radio) to be freed
+// once every reader that could still see it has left its read section.
+//
+// The only writer is the runtime thread: a reload, add or remove parses what
+// it needs, then holds globals.mutex (one of them at a time) while it hands
+// the change over with radio_cmd_call(). While the runtime thread isn't
+// running (loading, unloading) the change is simply made on the spot.
+//
+// Readers don't lock anything, they just bracket their use of the table:
+//
+//	int rcu = radio_rcu_read_lock();
+//	... Radios(x) ...
+//	radio_rcu_read_unlock(rcu);
+//
+// Never call radio_rcu_reclaim() from inside a read section, or on the
+// runtime thread (it waits for the runtime thread's read section to end).
+//
+struct Radio;
+
+struct RadioTable {
+   uint64_t	version;		// bumped every time a new table is published
+   int		size;			// slots in radio[]
+   struct Radio	*radio[];		// NULL (or a placeholder, once removed) = no radio in this slot
+};
+typedef struct RadioTable RadioTable_t;
+
+// Biggest radio # we'll grow the table to
+#define	RADIO_TABLE_MAX		256
+
+#define	radio_table()		__atomic_load_n(&globals.radios, __ATOMIC_ACQUIRE)
+
+extern int radio_rcu_read_lock(void);
+extern void radio_rcu_read_unlock(const int idx);
+extern void radio_rcu_synchronize(void);
+extern void radio_rcu_retire(void *ptr);
+extern void radio_rcu_retire_fn(void *ptr, void (*release)(void *ptr));
+extern void radio_rcu_reclaim(void);
+
+// Is there a radio in this slot?
+extern switch_bool_t radio_exists(const int radio);
+
+// Writers only: the runtime thread, through radio_cmd_call()
+extern struct Radio *radio_table_slot(const int radio);
+extern switch_status_t radio_table_remove(const int radio);
+extern void radio_table_retire(struct Radio *r);
+
+#endif	// !defined(RADIO_TABLE_H)
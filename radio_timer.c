@@ -0,0 +1,354 @@
+/*
+ * Timer wheel for per-radio deadlines
+ *
+ * TOT, penalty and ID deadlines used to be found by rescanning every radio
+ * each pass of the runtime loop. Instead each deadline is a RadioTimer_t
+ * hung on a hierarchical timer wheel (1ms ticks, 4 levels of 64 slots).
+ * A single timerfd is programmed for the next tick that has work to do, so
+ * the runtime thread only wakes when something is actually due.
+ */
+#include <sys/timerfd.h>
+#include "mod_hamradio.h"
+
+// Largest delta the wheel can hold, anything further out is recascaded
+#define	TIMER_WHEEL_SPAN	((uint64_t)1 << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS))
+
+struct TimerWheel {
+   RadioTimer_t	*slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+   RadioTimer_t	*expired;		// collected, waiting for their callback to run
+   uint64_t	now;			// last tick processed
+   uint64_t	programmed;		// tick the timerfd is set for (0 = disarmed)
+   int		count;			// timers on the wheel (not counting expired)
+   int		fd;			// timerfd
+   switch_mutex_t *mutex;
+};
+
+static struct TimerWheel wheel = { .fd = -1 };
+
+uint64_t radio_now_ms(void) {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ((uint64_t)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+///////////////////
+// List handling //
+///////////////////
+static void timer_link(RadioTimer_t **head, RadioTimer_t *t) {
+   t->slot = head;
+   t->prev = NULL;
+   t->next = *head;
+
+   if (*head) {
+      (*head)->prev = t;
+   }
+   *head = t;
+}
+
+static void timer_unlink(RadioTimer_t *t) {
+   if (t->prev) {
+      t->prev->next = t->next;
+   } else {
+      *t->slot = t->next;
+   }
+
+   if (t->next) {
+      t->next->prev = t->prev;
+   }
+
+   t->next = t->prev = NULL;
+   t->slot = NULL;
+}
+
+// Hang a timer on the wheel, relative to the current tick. Caller holds the lock.
+static void timer_place(RadioTimer_t *t) {
+   uint64_t exp = t->expires, delta;
+   int level;
+
+   // Overdue timers go in the next slot to be processed
+   if (exp <= wheel.now) {
+      exp = wheel.now + 1;
+   }
+
+   // Too far out for the wheel? park it as far as we can, it'll be recascaded
+   if ((delta = exp - wheel.now) >= TIMER_WHEEL_SPAN) {
+      exp = wheel.now + TIMER_WHEEL_SPAN - 1;
+      delta = TIMER_WHEEL_SPAN - 1;
+   }
+
+   for (level = 0; level < TIMER_WHEEL_LEVELS - 1; level++) {
+      if (delta < ((uint64_t)1 << ((level + 1) * TIMER_WHEEL_BITS))) {
+         break;
+      }
+   }
+
+   timer_link(&wheel.slots[level][(exp >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK], t);
+   wheel.count++;
+}
+
+// Move everything in a higher level slot down to where it belongs now
+static void timer_cascade(const int level, const int idx) {
+   RadioTimer_t *t = wheel.slots[level][idx];
+
+   wheel.slots[level][idx] = NULL;
+
+   while (t) {
+      RadioTimer_t *next = t->next;
+
+      t->next = t->prev = NULL;
+      t->slot = NULL;
+      wheel.count--;
+      timer_place(t);
+      t = next;
+   }
+}
+
+// Next tick with something to do (expiring slot or a non-empty cascade), 0 if the wheel is empty
+static uint64_t timer_next_tick(void) {
+   uint64_t next = 0;
+
+   if (wheel.count == 0) {
+      return 0;
+   }
+
+   for (int k = 1; k <= TIMER_WHEEL_SIZE; k++) {
+      if (wheel.slots[0][(wheel.now + k) & TIMER_WHEEL_MASK]) {
+         next = wheel.now + k;
+         break;
+      }
+   }
+
+   for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+      int shift = level * TIMER_WHEEL_BITS;
+      uint64_t upper = wheel.now >> shift;
+
+      for (int k = 1; k <= TIMER_WHEEL_SIZE; k++) {
+         if (wheel.slots[level][(upper + k) & TIMER_WHEEL_MASK]) {
+            uint64_t when = (upper + k) << shift;
+
+            if (next == 0 || when < next) {
+               next = when;
+            }
+            break;
+         }
+      }
+   }
+
+   return next;
+}
+
+// Point the timerfd at the next tick with work. Caller holds the lock.
+static void timer_program(void) {
+   struct itimerspec its;
+   uint64_t next = timer_next_tick();
+
+   if (next == wheel.programmed || wheel.fd < 0) {
+      return;
+   }
+
+   memset(&its, 0, sizeof(its));
+
+   // an all-zero it_value disarms the timerfd
+   if (next > 0) {
+      its.it_value.tv_sec = next / 1000;
+      its.it_value.tv_nsec = (next % 1000) * 1000000;
+   }
+
+   if (timerfd_settime(wheel.fd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[timer] timerfd_settime failed: %s\n", strerror(errno));
+      return;
+   }
+
+   wheel.programmed = next;
+}
+
+// Process ticks up to (and including) now, collecting expired timers. Caller holds the lock.
+static void timer_advance(const uint64_t now) {
+   while (wheel.now < now) {
+      uint64_t next;
+
+      // Nothing on the wheel, just catch up
+      if (wheel.count == 0) {
+         wheel.now = now;
+         break;
+      }
+
+      // Skip over ticks where nothing happens
+      if ((next = timer_next_tick()) == 0 || next > now) {
+         wheel.now = now;
+         break;
+      }
+
+      wheel.now = next;
+
+      // Cascade the higher levels down when the lower indexes wrap around
+      for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+         int shift = level * TIMER_WHEEL_BITS;
+
+         if ((wheel.now & (((uint64_t)1 << shift) - 1)) != 0) {
+            break;
+         }
+         timer_cascade(level, (wheel.now >> shift) & TIMER_WHEEL_MASK);
+      }
+
+      // Collect whatever is due in this slot
+      RadioTimer_t *t = wheel.slots[0][wheel.now & TIMER_WHEEL_MASK];
+
+      while (t) {
+         RadioTimer_t *next_t = t->next;
+
+         timer_unlink(t);
+         wheel.count--;
+
+         // Parked because it was out of range? put it back
+         if (t->expires > wheel.now) {
+            timer_place(t);
+         } else {
+            t->armed = 2;
+            timer_link(&wheel.expired, t);
+         }
+         t = next_t;
+      }
+   }
+}
+
+////////////////
+// Public API //
+////////////////
+switch_status_t radio_timer_init(void) {
+   if (wheel.fd >= 0) {
+      return SWITCH_STATUS_SUCCESS;
+   }
+
+   memset(&wheel, 0, sizeof(wheel));
+   switch_mutex_init(&wheel.mutex, SWITCH_MUTEX_NESTED, globals.pool);
+   wheel.now = radio_now_ms();
+
+   if ((wheel.fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "[timer] timerfd_create failed: %s\n", strerror(errno));
+      return SWITCH_STATUS_FALSE;
+   }
+
+   return SWITCH_STATUS_SUCCESS;
+}
+
+void radio_timer_fini(void) {
+   if (wheel.fd >= 0) {
+      close(wheel.fd);
+   }
+
+   // The timers themselves belong to the radios, just forget about them
+   memset(&wheel, 0, sizeof(wheel));
+   wheel.fd = -1;
+}
+
+int radio_timer_fd(void) {
+   return wheel.fd;
+}
+
+void radio_timer_setup(RadioTimer_t *t, const char *name, const int radio, radio_timer_cb_t cb, void *data) {
+   if (t->armed) {
+      return;
+   }
+
+   memset(t, 0, sizeof(*t));
+   t->name = name;
+   t->radio = radio;
+   t->cb = cb;
+   t->data = data;
+}
+
+void radio_timer_arm_at(RadioTimer_t *t, const uint64_t when_ms) {
+   if (!wheel.mutex || !t->cb) {
+      return;
+   }
+
+   switch_mutex_lock(wheel.mutex);
+
+   if (t->armed) {
+      timer_unlink(t);
+
+      if (t->armed == 1) {
+         wheel.count--;
+      }
+   }
+
+   t->expires = when_ms;
+   t->armed = 1;
+   timer_place(t);
+   timer_program();
+   switch_mutex_unlock(wheel.mutex);
+}
+
+void radio_timer_arm(RadioTimer_t *t, const uint64_t delay_ms) {
+   radio_timer_arm_at(t, radio_now_ms() + delay_ms);
+}
+
+void radio_timer_cancel(RadioTimer_t *t) {
+   if (!wheel.mutex) {
+      return;
+   }
+
+   switch_mutex_lock(wheel.mutex);
+
+   if (t->armed) {
+      timer_unlink(t);
+
+      if (t->armed == 1) {
+         wheel.count--;
+      }
+
+      t->armed = 0;
+      timer_program();
+   }
+   switch_mutex_unlock(wheel.mutex);
+}
+
+int radio_timer_armed(RadioTimer_t *t) {
+   return (t->armed != 0);
+}
+
+uint64_t radio_timer_remaining(RadioTimer_t *t) {
+   uint64_t now;
+
+   if (!t->armed) {
+      return 0;
+   }
+
+   now = radio_now_ms();
+   return (t->expires > now ? t->expires - now : 0);
+}
+
+// Called by the runtime thread when the timerfd is readable (or whenever it likes)
+void radio_timer_run(void) {
+   uint64_t junk;
+
+   if (!wheel.mutex) {
+      return;
+   }
+
+   // clear the readable state, we don't care how many times it fired
+   if (read(wheel.fd, &junk, sizeof(junk)) < 0 && errno != EAGAIN) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "[timer] reading timerfd failed: %s\n", strerror(errno));
+   }
+
+   switch_mutex_lock(wheel.mutex);
+   wheel.programmed = 0;
+   timer_advance(radio_now_ms());
+
+   // Run callbacks without the lock, they're free to arm/cancel timers
+   while (wheel.expired) {
+      RadioTimer_t *t = wheel.expired;
+
+      timer_unlink(t);
+      t->armed = 0;
+
+      switch_mutex_unlock(wheel.mutex);
+      t->cb(t->radio, t->data);
+      switch_mutex_lock(wheel.mutex);
+   }
+
+   timer_program();
+   switch_mutex_unlock(wheel.mutex);
+}
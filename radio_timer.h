@@ -0,0 +1,52 @@
+#if	!defined(RADIO_TIMER_H)
+#define	RADIO_TIMER_H
+#include <stdint.h>
+
+//
+// Hierarchical timer wheel for per-radio deadlines (TOT, penalty, ID, ...)
+//
+// Timers are embedded in whatever owns them (usually Radio_t) and are run
+// from the runtime thread when the timerfd (CLOCK_MONOTONIC) fires. Arming
+// and cancelling is O(1) and safe from any thread.
+//
+#define	TIMER_WHEEL_BITS	6
+#define	TIMER_WHEEL_SIZE	(1 << TIMER_WHEEL_BITS)
+#define	TIMER_WHEEL_MASK	(TIMER_WHEEL_SIZE - 1)
+#define	TIMER_WHEEL_LEVELS	4	// 1ms ticks, 64^4 ms = ~4.6 hours before we recascade
+
+typedef void (*radio_timer_cb_t)(const int radio, void *data);
+
+struct RadioTimer {
+   struct RadioTimer *next, *prev;	// wheel slot (or expired list) linkage
+   struct RadioTimer **slot;		// list we're on, so cancel is O(1)
+   uint64_t	expires;		// monotonic ms
+   radio_timer_cb_t cb;
+   void		*data;
+   int		radio;
+   int		armed;
+   const char	*name;			// for log messages
+};
+typedef struct RadioTimer RadioTimer_t;
+
+// Monotonic clock, in milliseconds
+extern uint64_t radio_now_ms(void);
+
+extern switch_status_t radio_timer_init(void);
+extern void radio_timer_fini(void);
+
+// fd for the runtime thread to wait on
+extern int radio_timer_fd(void);
+
+// Fill in a timer before first use (harmless on an armed timer, it's left alone)
+extern void radio_timer_setup(RadioTimer_t *t, const char *name, const int radio, radio_timer_cb_t cb, void *data);
+extern void radio_timer_arm(RadioTimer_t *t, const uint64_t delay_ms);
+extern void radio_timer_arm_at(RadioTimer_t *t, const uint64_t when_ms);
+extern void radio_timer_cancel(RadioTimer_t *t);
+extern int radio_timer_armed(RadioTimer_t *t);
+// ms left before the timer fires, 0 if not armed
+extern uint64_t radio_timer_remaining(RadioTimer_t *t);
+
+// Run any expired timers (runtime thread only)
+extern void radio_timer_run(void);
+
+#endif	// !defined(RADIO_TIMER_H)
@@ -6,13 +6,13 @@
 #include <switch.h>
 #include "mod_hamradio.h"
 
-// We should get called when [tones] section is encountered
-int radio_tones_init(void) {
+// Take over the [tones] parsed from hamradio.conf, dropping the old set. Table writers only (see radio_table.h)
+int radio_tones_set(dict *tones) {
     if (globals.radio_tones != NULL) {
        dict_free(globals.radio_tones);
     }
 
-    globals.radio_tones = dict_new();
+    globals.radio_tones = tones;
     return SWITCH_STATUS_SUCCESS;
 }
 
@@ -0,0 +1,255 @@
+/*
+ * Hot path trace rings
+ *
+ * switch_log_printf() takes locks and allocates, which is fine for the API
+ * but not for the runtime thread keying transmitters. Hot paths call
+ * radio_trace() instead, which drops a small binary record into a per-thread
+ * single-producer ring. A low priority drainer thread turns the records into
+ * log lines at its own pace (trace_drain_interval, trace_drain_max).
+ *
+ * A thread's ring is handed back when the thread exits (by a pthread key
+ * destructor) and given to the next thread that needs one, so threads that
+ * come and go don't leave a ring each behind. Producers trace inside an RCU
+ * read section, so radio_trace_fini() can wait them out before freeing.
+ */
+#include "mod_hamradio.h"
+#include <pthread.h>
+
+#define	TRACE_RING_SIZE		1024		// entries per thread, power of 2
+#define	TRACE_RING_MASK		(TRACE_RING_SIZE - 1)
+
+struct TraceRing {
+   struct TraceRing *next;			// all rings, newest first
+   int		in_use;				// owning thread still alive, 0 = free for the next one
+   uint64_t	head;				// written by the owning thread only
+   uint64_t	tail;				// written by the drainer only
+   uint64_t	dropped;			// ring was full
+   uint64_t	dropped_reported;		// drainer's copy of dropped
+   RadioTraceEntry_t entries[TRACE_RING_SIZE];
+};
+
+static struct {
+   struct TraceRing *rings;			// lock-free push-only list
+   int		generation;			// bumped on fini so stale thread-local rings are dropped
+   volatile int	running;
+   switch_thread_t *thread;
+   pthread_key_t key;				// hands a thread's ring back when it exits
+} trace;
+
+static __thread struct TraceRing *my_ring = NULL;
+static __thread int my_generation = 0;
+
+// How each event turns into a log line. If states is set a1/a2 are RadioStatus_t
+static const struct {
+   switch_log_level_t level;
+   switch_bool_t states;
+   const char *fmt;
+} trace_formats[TRACE_MAX] = {
+   [TRACE_STATE_CHANGE]    = { SWITCH_LOG_INFO,   true,  "[radio] radio%d STATUS change (%s) => (%s)\n" },
+   [TRACE_RX_END]          = { SWITCH_LOG_NOTICE, false, "[radio] radio%d was receiving for %ld s...\n" },
+   [TRACE_TX_END]          = { SWITCH_LOG_NOTICE, false, "[radio] radio%d was transmitting for %ld s...\n" },
+   [TRACE_SQUELCH]         = { SWITCH_LOG_DEBUG,  false, "radio%d squelch %ld (%ld glitches)\n" },
+   [TRACE_TOT_EXPIRED]     = { SWITCH_LOG_NOTICE, false, "radio%d ending transmission (TOT expired: %ld, adding %ld penalty)\n" },
+   [TRACE_PENALTY_CLEARED] = { SWITCH_LOG_DEBUG,  false, "radio%d penalty cleared\n" },
+   [TRACE_PTT_BLOCKED]     = { SWITCH_LOG_NOTICE, false, "radio%d TX refused, TOT penalty in effect (%ld s left)\n" },
+   [TRACE_COMMAND]         = { SWITCH_LOG_DEBUG,  false, "radio%d command #%ld applied, result %ld\n" },
+   [TRACE_DUTY_BLOCKED]    = { SWITCH_LOG_NOTICE, false, "radio%d TX refused, duty cycle budget (%ld%% over %ld s) used up\n" },
+   [TRACE_DUTY_EXHAUSTED]  = { SWITCH_LOG_NOTICE, false, "radio%d ending transmission, duty cycle budget (%ld%% over %ld s) used up\n" },
+};
+
+static void trace_format(const RadioTraceEntry_t *e) {
+   if (e->event >= TRACE_MAX) {
+      return;
+   }
+
+   if (trace_formats[e->event].states) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, trace_formats[e->event].level, trace_formats[e->event].fmt,
+         e->radio, radio_status_name(e->a1), radio_status_name(e->a2));
+   } else {
+      switch_log_printf(SWITCH_CHANNEL_LOG, trace_formats[e->event].level, trace_formats[e->event].fmt,
+         e->radio, (long)e->a1, (long)e->a2);
+   }
+}
+
+// First trace from this thread (or first since a reload), give it a ring:
+// one a thread that's gone left behind if there is one, otherwise a new one
+static struct TraceRing *trace_ring_new(void) {
+   struct TraceRing *ring;
+
+   for (ring = __atomic_load_n(&trace.rings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+      int unused = 0;
+
+      // Whatever the last owner left in it is still drained as usual
+      if (__atomic_compare_exchange_n(&ring->in_use, &unused, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+         break;
+      }
+   }
+
+   if (!ring) {
+      if (!(ring = calloc(1, sizeof(*ring)))) {
+         return NULL;
+      }
+
+      ring->in_use = 1;
+      ring->next = __atomic_load_n(&trace.rings, __ATOMIC_RELAXED);
+
+      while (!__atomic_compare_exchange_n(&trace.rings, &ring->next, ring, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+         ;
+      }
+   }
+
+   pthread_setspecific(trace.key, ring);
+   my_ring = ring;
+   my_generation = trace.generation;
+   return ring;
+}
+
+// A thread with a ring is exiting, let the next thread have it
+static void trace_ring_release(void *ptr) {
+   struct TraceRing *ring = ptr;
+   int rcu = radio_rcu_read_lock();
+
+   // Unless fini is already (or was) throwing the rings away
+   if (trace.running && my_generation == trace.generation) {
+      __atomic_store_n(&ring->in_use, 0, __ATOMIC_RELEASE);
+   }
+
+   my_ring = NULL;
+   radio_rcu_read_unlock(rcu);
+}
+
+static void trace_write(const RadioTraceEvent_t event, const int radio, const int64_t a1, const int64_t a2) {
+   struct TraceRing *ring = my_ring;
+   RadioTraceEntry_t *e;
+   uint64_t head;
+
+   if ((ring == NULL || my_generation != trace.generation) && !(ring = trace_ring_new())) {
+      return;
+   }
+
+   head = ring->head;
+
+   if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= TRACE_RING_SIZE) {
+      __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+      return;
+   }
+
+   e = &ring->entries[head & TRACE_RING_MASK];
+   e->ts = radio_now_ns();
+   e->event = event;
+   e->radio = radio;
+   e->a1 = a1;
+   e->a2 = a2;
+   __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void radio_trace(const RadioTraceEvent_t event, const int radio, const int64_t a1, const int64_t a2) {
+   // fini waits for this read section to close before it frees the rings
+   int rcu = radio_rcu_read_lock();
+
+   if (trace.running) {
+      trace_write(event, radio, a1, a2);
+      radio_rcu_read_unlock(rcu);
+      return;
+   }
+
+   radio_rcu_read_unlock(rcu);
+
+   // No drainer (loading/unloading), log it directly
+   RadioTraceEntry_t tmp = { radio_now_ns(), event, radio, a1, a2 };
+   trace_format(&tmp);
+}
+
+// Format up to max entries from every ring, returns how many were done
+static int trace_drain(const int max) {
+   int done = 0;
+
+   for (struct TraceRing *ring = __atomic_load_n(&trace.rings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+      uint64_t tail = ring->tail;
+      uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+      uint64_t dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+      int n = 0;
+
+      while (tail != head && (max <= 0 || n < max)) {
+         trace_format(&ring->entries[tail & TRACE_RING_MASK]);
+         tail++;
+         n++;
+      }
+
+      __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+      done += n;
+
+      if (dropped != ring->dropped_reported) {
+         switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "[trace] ring full, %" PRIu64 " events dropped\n", dropped - ring->dropped_reported);
+         ring->dropped_reported = dropped;
+      }
+   }
+
+   return done;
+}
+
+static void *SWITCH_THREAD_FUNC trace_thread(switch_thread_t *thread, void *obj) {
+   while (trace.running) {
+      // Read every pass, so a reload takes effect on the next one
+      trace_drain(dconf_int(CFGH_TRACE_DRAIN_MAX));
+      switch_yield(dconf_msecs(CFGH_TRACE_DRAIN_INTERVAL) * 1000);
+   }
+
+   return NULL;
+}
+
+switch_status_t radio_trace_init(void) {
+   switch_threadattr_t *thd_attr = NULL;
+
+   if (trace.running) {
+      return SWITCH_STATUS_SUCCESS;
+   }
+
+   if (pthread_key_create(&trace.key, trace_ring_release) != 0) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[trace] couldn't create thread key, logging directly\n");
+      return SWITCH_STATUS_FALSE;
+   }
+
+   trace.running = 1;
+
+   switch_threadattr_create(&thd_attr, globals.pool);
+   switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+   if (switch_thread_create(&trace.thread, thd_attr, trace_thread, NULL, globals.pool) != SWITCH_STATUS_SUCCESS) {
+      switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "[trace] couldn't start drainer thread, logging directly\n");
+      trace.running = 0;
+      pthread_key_delete(trace.key);
+      return SWITCH_STATUS_FALSE;
+   }
+
+   return SWITCH_STATUS_SUCCESS;
+}
+
+void radio_trace_fini(void) {
+   switch_status_t st;
+   struct TraceRing *ring;
+
+   if (!trace.running) {
+      return;
+   }
+
+   trace.running = 0;
+   switch_thread_join(&st, trace.thread);
+   trace.thread = NULL;
+
+   // No more ring hand-backs, and wait out producers (and exiting threads) that
+   // saw us running: new ones log directly from here on
+   pthread_key_delete(trace.key);
+   radio_rcu_synchronize();
+
+   // Flush whatever is left and throw the rings away
+   trace_drain(0);
+   ring = __atomic_exchange_n(&trace.rings, NULL, __ATOMIC_ACQ_REL);
+   trace.generation++;
+
+   while (ring) {
+      struct TraceRing *next = ring->next;
+      free(ring);
+      ring = next;
+   }
+}
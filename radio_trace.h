@@ -0,0 +1,40 @@
+#if	!defined(RADIO_TRACE_H)
+#define	RADIO_TRACE_H
+#include <stdint.h>
+
+//
+// Non-blocking trace of hot path events
+//
+// Each thread writes fixed size binary records into its own lock-free ring,
+// and a background thread formats them into the switch log every
+// trace_drain_interval ms. Calling radio_trace() never takes a lock,
+// allocates, or formats a string (after the thread's first call). A ring
+// goes back to a free list when its thread exits, for the next thread to use.
+//
+typedef enum RadioTraceEvent {
+   TRACE_STATE_CHANGE = 0,	// a1 = old status, a2 = new status
+   TRACE_RX_END,		// a1 = seconds received
+   TRACE_TX_END,		// a1 = seconds transmitted
+   TRACE_SQUELCH,		// a1 = debounced level, a2 = glitches so far
+   TRACE_TOT_EXPIRED,		// a1 = timeout_talk, a2 = timeout_holdoff
+   TRACE_PENALTY_CLEARED,
+   TRACE_PTT_BLOCKED,		// a1 = penalty seconds remaining
+   TRACE_COMMAND,		// a1 = ticket, a2 = result
+   TRACE_DUTY_BLOCKED,		// a1 = duty cycle %, a2 = window seconds
+   TRACE_DUTY_EXHAUSTED,	// a1 = duty cycle %, a2 = window seconds
+   TRACE_MAX
+} RadioTraceEvent_t;
+
+struct RadioTraceEntry {
+   uint64_t	ts;		// monotonic ns
+   uint16_t	event;
+   int16_t	radio;
+   int64_t	a1, a2;
+};
+typedef struct RadioTraceEntry RadioTraceEntry_t;
+
+extern switch_status_t radio_trace_init(void);
+extern void radio_trace_fini(void);
+extern void radio_trace(const RadioTraceEvent_t event, const int radio, const int64_t a1, const int64_t a2);
+
+#endif	// !defined(RADIO_TRACE_H)